@@ -0,0 +1,109 @@
+/**
+ *  @file   AtomicBinsBench.cpp
+ *  @brief  Benchmark that finds the number of bins up to which shared atomic bins are faster than per-thread copies (see ThrObj::SetSharedAtomicBins)
+ *
+ *  Usage: AtomicBinsBench [-j nThreads] [-f nFills]
+ *
+ *  For each number of bins one TH1D histogram is filled on all threads with uniformly distributed values, first with per-thread copies and then with shared atomic bins, and is then written into the memory file. The time from the start of the threads until the histogram is written is measured, hence the merge of per-thread copies is included. The crossover is the largest number of bins for which shared atomic bins were faster.
+ *
+ *  This file is a part of a project ROOTTools (https://github.com/Sergeyir/ROOTTools).
+ *
+ *  @author Sergei Antsupov (antsupov0124@gmail.com)
+ **/
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+
+#include "TMemFile.h"
+
+#include "ThrObj.hpp"
+
+/// Fills the histogram with nBins bins with values on all threads and writes it; returns the time in seconds
+double FillAndWrite(const int nBins, const bool sharedAtomicBins,
+                    const std::vector<std::vector<double>>& values)
+{
+   TMemFile file("AtomicBinsBench.root", "RECREATE");
+   TDirectory::TContext context(&file);
+
+   ROOTTools::ThrObjHolder::Holder holder;
+   ROOTTools::ThrObj<TH1D> hist("h", "", nBins, 0., 1., "", holder);
+   if (sharedAtomicBins) hist.SetSharedAtomicBins();
+
+   const auto start = std::chrono::steady_clock::now();
+   std::vector<std::thread> pool;
+   for (const std::vector<double>& threadValues : values)
+   {
+      pool.emplace_back([&]()
+      {
+         for (const double value : threadValues) hist.Fill(value);
+      });
+   }
+   for (std::thread& thr : pool) thr.join();
+   holder.Write();
+   const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+   return duration.count();
+}
+
+int main(int argc, char **argv)
+{
+   unsigned int nThreads = 0;
+   std::size_t nFills = 10000000;
+
+   for (int i = 1; i < argc; i++)
+   {
+      const std::string arg = argv[i];
+      const std::string value = (i + 1 < argc) ? argv[++i] : "";
+      if ((arg != "-j" && arg != "-f") ||
+          value == "" || value.find_first_not_of("0123456789") != std::string::npos)
+      {
+         std::cout << "Usage: AtomicBinsBench [-j nThreads] [-f nFills]" << std::endl;
+         std::cout << "   -j number of threads; 0 means the number of hardware threads (default)" << std::endl;
+         std::cout << "   -f number of values filled by each thread (default 10000000)" << std::endl;
+         return 1;
+      }
+      if (arg == "-j") nThreads = std::stoul(value);
+      else nFills = std::stoul(value);
+   }
+   if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+
+   ROOT::EnableThreadSafety();
+
+   // values are generated in advance so that the generator is not timed
+   std::vector<std::vector<double>> values(nThreads);
+   for (unsigned int i = 0; i < nThreads; i++)
+   {
+      std::mt19937_64 generator(i);
+      std::uniform_real_distribution<double> distribution(0., 1.);
+      values[i].resize(nFills);
+      for (double& value : values[i]) value = distribution(generator);
+   }
+
+   std::cout << nThreads << " threads, " << nFills << " fills per thread" << std::endl;
+   std::cout << std::setw(10) << "bins" << std::setw(14) << "copies, s" <<
+                std::setw(14) << "atomic, s" << std::setw(12) << "speedup" << std::endl;
+
+   int crossover = 0;
+   for (const int nBins : {10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000})
+   {
+      const double copiesSeconds = FillAndWrite(nBins, false, values);
+      const double atomicSeconds = FillAndWrite(nBins, true, values);
+      if (atomicSeconds < copiesSeconds) crossover = nBins;
+      std::cout << std::setw(10) << nBins << std::setprecision(4) <<
+                   std::setw(14) << copiesSeconds << std::setw(14) << atomicSeconds <<
+                   std::setw(12) << copiesSeconds/atomicSeconds << std::endl;
+   }
+
+   if (crossover == 0)
+   {
+      std::cout << "Per-thread copies were faster for all numbers of bins" << std::endl;
+   }
+   else
+   {
+      std::cout << "Shared atomic bins were faster up to " << crossover << " bins" << std::endl;
+   }
+   return 0;
+}
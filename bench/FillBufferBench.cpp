@@ -0,0 +1,104 @@
+/**
+ *  @file   FillBufferBench.cpp
+ *  @brief  Benchmark that compares the throughput of ThrObj::Fill with and without the fill buffer (see ThrObj::SetFillBuffer)
+ *
+ *  Usage: FillBufferBench [-j nThreads] [-e nEvents] [-n nHists] [-b nBins]
+ *
+ *  Every thread fills each of nHists histograms once per event, which is the case the fill buffer is intended for: without the buffer every fill touches the bin array of a different histogram. For each buffer size the time from the start of the threads until all of them filled all events and flushed their buffers is measured.
+ *
+ *  This file is a part of a project ROOTTools (https://github.com/Sergeyir/ROOTTools).
+ *
+ *  @author Sergei Antsupov (antsupov0124@gmail.com)
+ **/
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <random>
+#include <chrono>
+
+#include "ThrObj.hpp"
+
+int main(int argc, char **argv)
+{
+   unsigned int nThreads = 0;
+   std::size_t nEvents = 100000;
+   std::size_t nHists = 200;
+   std::size_t nBins = 10000;
+
+   for (int i = 1; i < argc; i++)
+   {
+      const std::string arg = argv[i];
+      const std::string value = (i + 1 < argc) ? argv[++i] : "";
+      if ((arg != "-j" && arg != "-e" && arg != "-n" && arg != "-b") ||
+          value == "" || value.find_first_not_of("0123456789") != std::string::npos)
+      {
+         std::cout << "Usage: FillBufferBench [-j nThreads] [-e nEvents] [-n nHists] [-b nBins]" << std::endl;
+         std::cout << "   -j number of threads; 0 means the number of hardware threads (default)" << std::endl;
+         std::cout << "   -e number of events filled by each thread (default 100000)" << std::endl;
+         std::cout << "   -n number of histograms filled in each event (default 200)" << std::endl;
+         std::cout << "   -b number of bins of each histogram (default 10000)" << std::endl;
+         return 1;
+      }
+      if (arg == "-j") nThreads = std::stoul(value);
+      else if (arg == "-e") nEvents = std::stoul(value);
+      else if (arg == "-n") nHists = std::stoul(value);
+      else nBins = std::stoul(value);
+   }
+   if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+
+   ROOT::EnableThreadSafety();
+
+   // values are generated in advance so that the generator is not timed
+   std::vector<std::vector<double>> values(nThreads);
+   for (unsigned int i = 0; i < nThreads; i++)
+   {
+      std::mt19937_64 generator(i);
+      std::uniform_real_distribution<double> distribution(0., 1.);
+      values[i].resize(nEvents);
+      for (double& value : values[i]) value = distribution(generator);
+   }
+
+   std::cout << nThreads << " threads, " << nEvents << " events, " << nHists <<
+                " histograms of " << nBins << " bins" << std::endl;
+   std::cout << std::setw(12) << "buffer" << std::setw(12) << "seconds" <<
+                std::setw(16) << "Mfills/s" << std::setw(12) << "speedup" << std::endl;
+
+   double directSeconds = 0.;
+   for (const std::size_t bufferSize : {0, 64, 256, 1024, 4096})
+   {
+      ROOTTools::ThrObjHolder::Holder holder;
+      std::vector<std::unique_ptr<ROOTTools::ThrObj<TH1D>>> hists;
+      for (std::size_t i = 0; i < nHists; i++)
+      {
+         hists.emplace_back(new ROOTTools::ThrObj<TH1D>("h" + std::to_string(i), "",
+                                                       nBins, 0., 1., "", holder));
+         hists.back()->SetFillBuffer(bufferSize);
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> pool;
+      for (unsigned int i = 0; i < nThreads; i++)
+      {
+         pool.emplace_back([&, i]()
+         {
+            for (const double value : values[i])
+            {
+               for (std::unique_ptr<ROOTTools::ThrObj<TH1D>>& hist : hists) hist->Fill(value);
+            }
+            for (std::unique_ptr<ROOTTools::ThrObj<TH1D>>& hist : hists) hist->FlushFillBuffer();
+         });
+      }
+      for (std::thread& thr : pool) thr.join();
+      const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+      if (bufferSize == 0) directSeconds = duration.count();
+      const double nFills = static_cast<double>(nThreads)*nEvents*nHists;
+      std::cout << std::setw(12) << bufferSize << std::setw(12) << std::setprecision(4) <<
+                   duration.count() << std::setw(16) << nFills/duration.count()/1e6 <<
+                   std::setw(12) << directSeconds/duration.count() << std::endl;
+   }
+   return 0;
+}
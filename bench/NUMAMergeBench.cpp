@@ -0,0 +1,121 @@
+/**
+ *  @file   NUMAMergeBench.cpp
+ *  @brief  Benchmark that compares the fill and the merge of per-thread copies with and without NUMA-aware merge (see ThrObjHolder::Holder::SetNUMAAwareMerge)
+ *
+ *  Usage: NUMAMergeBench [-j nThreads] [-e nEvents] [-n nHists] [-b nBins]
+ *
+ *  Threads are bound to the CPUs allowed for the process one by one so that their copies are spread over all NUMA nodes. Each thread fills every histogram with uniformly distributed values, after which the histograms are written into the memory file. Times of the fill and of the write (mostly the merge) are measured separately for the default and the NUMA-aware merge, each with serial and parallel merge (see ThrObjHolder::Holder::SetParallelMerge). On systems with one node both modes merge the same way.
+ *
+ *  This file is a part of a project ROOTTools (https://github.com/Sergeyir/ROOTTools).
+ *
+ *  @author Sergei Antsupov (antsupov0124@gmail.com)
+ **/
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <random>
+#include <chrono>
+
+#include "TMemFile.h"
+
+#include "ThrObj.hpp"
+
+int main(int argc, char **argv)
+{
+   unsigned int nThreads = 0;
+   std::size_t nEvents = 1000000;
+   std::size_t nHists = 20;
+   std::size_t nBins = 500;
+
+   for (int i = 1; i < argc; i++)
+   {
+      const std::string arg = argv[i];
+      const std::string value = (i + 1 < argc) ? argv[++i] : "";
+      if ((arg != "-j" && arg != "-e" && arg != "-n" && arg != "-b") ||
+          value == "" || value.find_first_not_of("0123456789") != std::string::npos)
+      {
+         std::cout << "Usage: NUMAMergeBench [-j nThreads] [-e nEvents] [-n nHists] [-b nBins]" << std::endl;
+         std::cout << "   -j number of threads; 0 means the number of hardware threads (default)" << std::endl;
+         std::cout << "   -e number of events filled by each thread (default 1000000)" << std::endl;
+         std::cout << "   -n number of histograms filled in each event (default 20)" << std::endl;
+         std::cout << "   -b number of bins on each axis of each TH2D histogram (default 500)" << std::endl;
+         return 1;
+      }
+      if (arg == "-j") nThreads = std::stoul(value);
+      else if (arg == "-e") nEvents = std::stoul(value);
+      else if (arg == "-n") nHists = std::stoul(value);
+      else nBins = std::stoul(value);
+   }
+   if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+
+   ROOT::EnableThreadSafety();
+
+   const std::vector<int> cpus = ROOTTools::ThrObjHolder::GetCPUAffinity();
+
+   // values are generated in advance so that the generator is not timed
+   std::vector<std::vector<double>> values(nThreads);
+   for (unsigned int i = 0; i < nThreads; i++)
+   {
+      std::mt19937_64 generator(i);
+      std::uniform_real_distribution<double> distribution(0., 1.);
+      values[i].resize(2*nEvents);
+      for (double& value : values[i]) value = distribution(generator);
+   }
+
+   std::cout << nThreads << " threads on " << cpus.size() << " CPUs, " << nEvents << " events, " <<
+                nHists << " histograms of " << nBins << "x" << nBins << " bins" << std::endl;
+   std::cout << std::setw(10) << "merge" << std::setw(10) << "parallel" <<
+                std::setw(12) << "fill, s" << std::setw(12) << "write, s" << std::endl;
+
+   for (const bool numaAwareMerge : {false, true})
+   {
+      for (const bool parallelMerge : {false, true})
+      {
+         TMemFile file("NUMAMergeBench.root", "RECREATE");
+         TDirectory::TContext context(&file);
+
+         ROOTTools::ThrObjHolder::Holder holder;
+         holder.SetNUMAAwareMerge(numaAwareMerge);
+         holder.SetParallelMerge(parallelMerge, nThreads);
+         std::vector<std::unique_ptr<ROOTTools::ThrObj<TH2D>>> hists;
+         for (std::size_t i = 0; i < nHists; i++)
+         {
+            hists.emplace_back(new ROOTTools::ThrObj<TH2D>("h" + std::to_string(i), "",
+                                                          nBins, 0., 1., nBins, 0., 1., "", holder));
+         }
+
+         const auto start = std::chrono::steady_clock::now();
+         std::vector<std::thread> pool;
+         for (unsigned int i = 0; i < nThreads; i++)
+         {
+            pool.emplace_back([&, i]()
+            {
+               // copies are first touched by the thread that fills them hence they are placed on its node
+               if (cpus.size() > 0) ROOTTools::ThrObjHolder::SetCPUAffinity({cpus[i % cpus.size()]});
+               for (std::size_t j = 0; j < nEvents; j++)
+               {
+                  for (std::unique_ptr<ROOTTools::ThrObj<TH2D>>& hist : hists)
+                  {
+                     hist->Fill(values[i][2*j], values[i][2*j + 1]);
+                  }
+               }
+            });
+         }
+         for (std::thread& thr : pool) thr.join();
+         const auto filled = std::chrono::steady_clock::now();
+         holder.Write();
+         const auto written = std::chrono::steady_clock::now();
+
+         const std::chrono::duration<double> fillDuration = filled - start;
+         const std::chrono::duration<double> writeDuration = written - filled;
+         std::cout << std::setw(10) << (numaAwareMerge ? "NUMA" : "default") <<
+                      std::setw(10) << (parallelMerge ? "yes" : "no") << std::setprecision(4) <<
+                      std::setw(12) << fillDuration.count() <<
+                      std::setw(12) << writeDuration.count() << std::endl;
+      }
+   }
+   return 0;
+}
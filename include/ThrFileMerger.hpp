@@ -0,0 +1,73 @@
+/**
+ *  @file   ThrFileMerger.hpp
+ *  @brief  Contains functions that merge many ROOT files with the same layout (e.g. the ones written by ThrObjHolder in parallel jobs) on multiple threads
+ *
+ *  In order to use these functions libThrFileMerger.so must be loaded
+ *
+ *  This file is a part of a project ROOTTools (https://github.com/Sergeyir/ROOTTools).
+ *
+ *  @author Sergei Antsupov (antsupov0124@gmail.com)
+ **/
+#ifndef ROOT_TOOLS_THR_FILE_MERGER_HPP
+#define ROOT_TOOLS_THR_FILE_MERGER_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+
+#include "TROOT.h"
+#include "TFile.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TTree.h"
+
+/// @namespace ROOTTools
+namespace ROOTTools
+{
+   /*! @namespace ThrFileMerger
+    * @brief Merges many files with the same layout on multiple threads. The only useful function for user is Merge; it can also be called from the command line with ThrMerge executable
+    */
+   namespace ThrFileMerger
+   {
+      /*! @brief Merges objects from the input files into the output file keeping the directory structure
+       *
+       * The layout of keys (directories and names of objects) is read once from the first input file and the objects with the same directories and names are read from all input files; objects that are absent in the first file are not merged. Input files are split between threads in contiguous blocks and every thread merges the objects from its files into its partial sums; after that the partial sums of all threads are merged pairwise in a tree of log2(number of threads) depth on the same threads. Objects are processed in batches of maxObjectsInFlight keys and every batch is written before the next one is read, hence at most about maxObjectsInFlight*(nThreads + 1) objects are in memory at once. Objects that can not be merged (i.e. their class has no Merge function) are taken from the first file. Trees are merged after all other objects by copying their compressed baskets from all files in the order of input files. The output file is compressed with the same settings as the first input file. ROOT::EnableThreadSafety() is called by this function
+       *
+       * @param[in] outputFileName name of the output file which will be overwritten if it already exists, otherwise it will be created
+       * @param[in] inputFileNames names of the input files
+       * @param[in] nThreads number of threads; if 0 is passed std::thread::hardware_concurrency() is used
+       * @param[in] maxObjectsInFlight number of keys that are merged at once
+       */
+      void Merge(const std::string& outputFileName, const std::vector<std::string>& inputFileNames,
+                 unsigned int nThreads = 0, const std::size_t maxObjectsInFlight = 64);
+
+      // other functions and variables below are not intended for the user
+      // and are called/accessed automaticaly
+
+      /// Not intended for user. Object in the layout of the files
+      struct Key
+      {
+         /// path of the directory of the object ("" for the top directory)
+         std::string dir;
+         /// name of the object
+         std::string name;
+         /// shows whether the object is a tree
+         bool isTree;
+      };
+      /// Not intended for user. Adds the paths of all subdirectories of dir and all objects in them to dirs and keys; only the last cycle of each object is taken
+      void ReadLayout(TDirectory *dir, const std::string& path,
+                      std::vector<std::string>& dirs, std::vector<Key>& keys);
+      /// Not intended for user. Reads the object detaching it from the directory of the file; returns nullptr if it is absent
+      TObject *ReadObject(TFile *file, const Key& key);
+      /// Not intended for user. Merges source into target with the merge function of their class; returns false if the class has no merge function
+      bool MergeObject(TObject *target, TObject *source);
+      /// Not intended for user. Calls func(i) for every i in [0, n) on nThreads threads
+      void ParallelFor(const std::size_t n, const unsigned int nThreads,
+                       const std::function<void(const std::size_t)>& func);
+   };
+};
+
+#endif /* ROOT_TOOLS_THR_FILE_MERGER_HPP */
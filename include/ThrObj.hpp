@@ -14,13 +14,38 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include <typeindex>
+#include <future>
+#include <chrono>
 
+#include "TROOT.h"
 #include "TFile.h"
+#include "TList.h"
 #include "TH1.h"
 #include "TH2.h"
 #include "TH3.h"
+#include "TProfile.h"
+#include "TProfile2D.h"
+#include "TEfficiency.h"
+#include "TParameter.h"
+#include "TTree.h"
+#include "TMemFile.h"
+#include "TChain.h"
+#include "TTreeReader.h"
 
 #include "ROOT/TThreadedObject.hxx"
+#include "ROOT/RSpan.hxx"
 
 /// @namespace ROOTTools
 namespace ROOTTools
@@ -28,78 +53,697 @@ namespace ROOTTools
    /// @namespace ThrObjHolder container that stores histograms of ThrObj class
    namespace ThrObjHolder
    { 
-      /*! @brief Call this function to merge and write histograms in the current open TDirectory (i.e. gDirectory)
+      /// Not intended for user. Base of storages of ThrObj that keep filled values outside of the histograms (fill buffers, shared atomic bins, etc.); storages are owned by the holder so that they are flushed into the histograms in Write even after their ThrObj is destroyed
+      struct Flushable
+      {
+         virtual ~Flushable() = default;
+         /// Fills all stored values into the histogram and empties the storage
+         virtual void Flush() = 0;
+         /// Empties the storage discarding all stored values
+         virtual void Reset() = 0;
+      };
+
+      /// Not intended for user. Every fillTimingPeriod-th call of ThrObj::Fill on each thread is timed when fill statistics are collected (see Holder::PrintFillStats), since reading the clock costs more than most fills
+      constexpr std::uint64_t fillTimingPeriod = 64;
+
+      /// Not intended for user. Fill statistics of one ThrObj on one thread; aligned so that different threads never write to the same cache line
+      struct alignas(64) FillCounter
+      {
+         /// number of filled values
+         std::uint64_t nFills = 0;
+         /// number of filled values which time was measured
+         std::uint64_t nTimedFills = 0;
+         /// time of the timed fills in seconds
+         double timedSeconds = 0.;
+         /// number of fills until the next timed one
+         std::uint64_t untilTimed = 0;
+      };
+
+      /// Not intended for user. Fill statistics of all threads of one ThrObj
+      struct FillCounters
+      {
+         FillCounters(const std::string& name, const std::string& directory);
+         /// Adds the counter for the calling thread; this function is called on the first fill on each thread
+         FillCounter& AddCounter();
+         /// name of the histogram
+         std::string name;
+         /// directory of the histogram
+         std::string directory;
+         /// counters of all threads; std::deque is used so that references stay valid when counters are added
+         std::deque<FillCounter> counters;
+         /// mutex for counters since they are added from different threads
+         std::mutex countersMutex;
+      };
+
+      /// Not intended for user. Page-aligned memory blocks of one thread from which bin arrays of its copies are carved (see Holder::SetArena); blocks are unmapped when the last copy carved from them is deleted
+      class Arena
+      {
+         public:
+         /*! @brief Constructor
+          * @param[in] blockSize minimum size of each mapped block in bytes
+          * @param[in] hugePages if true blocks are advised to be backed by transparent huge pages
+          */
+         Arena(const std::size_t blockSize, const bool hugePages);
+         /// Unmaps all blocks
+         ~Arena();
+         /// Arena owns its blocks hence it can not be copied
+         Arena(const Arena&) = delete;
+         /// Arena owns its blocks hence it can not be copied
+         Arena& operator=(const Arena&) = delete;
+         /// Returns zero-initialized memory of nBytes size aligned to the cache line
+         void *Allocate(const std::size_t nBytes);
+
+         protected:
+         /// Maps the block that is at least nBytes long and makes it the current one
+         void AddBlock(const std::size_t nBytes);
+         /// Mapped blocks (address and size)
+         std::vector<std::pair<char *, std::size_t>> blocks;
+         /// minimum size of each block
+         std::size_t blockSize;
+         /// shows whether blocks are advised to be backed by huge pages
+         bool hugePages;
+         /// offset of the free memory in the current (last) block
+         std::size_t offset = 0;
+      };
+
+      /// Not intended for user. Threads that are started once per Holder::Write and run all of its parallel steps (flush of storages, merge, reset)
+      class ThreadPool
+      {
+         public:
+         /*! @brief Constructor; starts nThreads - 1 threads since the thread that calls Run takes part in the work as well
+          * @param[in] nThreads number of threads; if 0 is passed std::thread::hardware_concurrency() is used
+          */
+         ThreadPool(unsigned int nThreads);
+         /// Stops and joins all threads
+         ~ThreadPool();
+         /// Pool owns its threads hence it can not be copied
+         ThreadPool(const ThreadPool&) = delete;
+         /// Pool owns its threads hence it can not be copied
+         ThreadPool& operator=(const ThreadPool&) = delete;
+         /// Calls func(i) for every i in [0, n) on all threads of the pool and returns when all calls are finished; must not be called from func itself
+         void Run(const std::size_t n, const std::function<void(const std::size_t)>& func);
+
+         protected:
+         /// Takes part in every Run call until the pool is destroyed; this function is run by every thread of the pool
+         void Work();
+         /// Calls the function of the current Run call for indices that are handed out one by one until all of them are taken
+         void RunIndices();
+         /// threads of the pool except the one that calls Run
+         std::vector<std::thread> threads;
+         /// mutex for the state of the current Run call
+         std::mutex mutex;
+         /// notifies threads of the pool that Run was called or that the pool is being destroyed
+         std::condition_variable runStarted;
+         /// notifies Run that one of the threads has finished its part
+         std::condition_variable runFinished;
+         /// function of the current Run call
+         const std::function<void(const std::size_t)> *func = nullptr;
+         /// number of indices of the current Run call
+         std::size_t n = 0;
+         /// next index that is not taken yet
+         std::atomic<std::size_t> nextIndex{0};
+         /// number of Run calls so far; threads compare it with the number of calls they took part in
+         std::uint64_t nRuns = 0;
+         /// number of threads that have not finished their part of the current Run call
+         std::size_t nBusy = 0;
+         /// shows whether the pool is being destroyed
+         bool isStopped = false;
+      };
+
+      /// Not intended for user. Hands out indices of objects of one class in the thread local caches of this class; indices of destroyed objects are handed out again so that the caches do not grow when objects are created anew (e.g. for every run)
+      class CacheIndices
+      {
+         public:
+         /// Returns the free index together with the id that was never returned before
+         std::pair<std::size_t, std::uint64_t> Acquire();
+         /// Makes the index free
+         void Release(const std::size_t index);
+
+         protected:
+         /// indices of destroyed objects
+         std::vector<std::size_t> freeIndices;
+         /// number of indices that were handed out
+         std::size_t nIndices = 0;
+         /// number of ids that were handed out; ids start from 1 so that 0 marks empty entries of caches
+         std::uint64_t nIds = 0;
+         /// mutex for indices since objects are created and destroyed on different threads
+         std::mutex mutex;
+      };
+
+      /// Not intended for user. Index of the object in the thread local caches of its class together with its id; cache entries with another id were left by a destroyed object and are cleared before use
+      class CacheIndex
+      {
+         public:
+         /// Acquires the index
+         CacheIndex(CacheIndices& indices);
+         /// Acquires another index
+         CacheIndex(const CacheIndex& other);
+         /// Keeps the index of this object with the new id since the entries of the caches belong to the previous state
+         CacheIndex& operator=(const CacheIndex& other);
+         /// Releases the index
+         ~CacheIndex();
+         /// index in the caches
+         std::size_t index;
+         /// id that is unique among all objects of the class
+         std::uint64_t id;
+
+         protected:
+         /// indices of the class
+         CacheIndices *indices;
+      };
+
+      /// Not intended for user. Trees of all threads of one ThrTree; each tree is attached to its own TMemFile into which its baskets are compressed and written by the thread that fills it
+      struct ThreadTrees
+      {
+         /// Tree of one thread together with the file that owns it
+         struct Slot
+         {
+            /// memory file into which baskets of the tree are written
+            std::unique_ptr<TMemFile> file;
+            /// tree of the thread; owned by the file
+            TTree *tree;
+         };
+         ThreadTrees(const std::string& name, const std::string& title);
+         /// Creates the tree for the calling thread; this function is called on the first ThrTree::Get on each thread
+         TTree *AddTree();
+         /// name of the trees
+         std::string name;
+         /// title of the trees
+         std::string title;
+         /// trees of all threads in the order in which they were created
+         std::vector<Slot> slots;
+         /// mutex for slots since they are added from different threads
+         std::mutex slotsMutex;
+      };
+
+      /*! @brief Not intended for user. Values of one ThrObj that are written in checkpoints (see Holder::Checkpoint)
+       *
+       * Every thread that fills the histogram has two sides of its objects: it fills one and switches to the other on its first fill in the new checkpoint epoch, after which the checkpoint thread moves the values of the side that was left into the sum. Hence the checkpoint thread never reads the side that is being filled
        */
-      void Write();
-      /*! @brief Call this function to merge and write histograms in the specified file which will be overwritten if it already exists, otherwise it will be created
-       * @param[in] outputFileName name of the output file
+      template<typename T>
+      struct CheckpointValues
+      {
+         /// Objects of one thread
+         struct Participant
+         {
+            /// epoch in which the thread switched sides last time; stored by the thread after the switch
+            std::atomic<std::uint64_t> epoch{0};
+            /// side (0 or 1) that the thread fills; the other side holds the values filled before the last switch. Changed only by the thread before it stores epoch
+            unsigned int side = 0;
+            /// move the values of the passed side of each object of the thread into the histogram and empty this side
+            std::vector<std::function<void(T *, const unsigned int)>> moveValues;
+            /// second copy of the histogram of the thread; nullptr if the thread fills only the storage of the fill mode
+            std::shared_ptr<T> spareHist;
+         };
+         /// Constructor; createEmpty returns the new empty histogram with the same axes as the ones of ThrObj
+         CheckpointValues(const std::function<T *()>& createEmpty);
+         /// Adds the calling thread that starts filling in the epoch; this function is called on the first fill on each thread
+         Participant& AddParticipant(const std::uint64_t epoch);
+         /// Adds the object of the participant whose values are moved with moveValues; spareHist is passed for the copy of the histogram
+         void AddValues(Participant& participant, 
+                        const std::function<void(T *, const unsigned int)>& moveValues,
+                        const std::shared_ptr<T>& spareHist = nullptr);
+         /// Waits until all threads switch to the epoch or until deadline, moves the values that the switched threads left into sum, and returns the copy of sum; nullptr if nothing was filled. Threads that did not switch are counted in nStale
+         std::shared_ptr<T> GetSnapshot(const std::uint64_t epoch,
+                                        const std::chrono::steady_clock::time_point deadline,
+                                        std::size_t& nStale);
+         /// Discards sum and the values of the spare copies; this function is called in Holder::Reset
+         void Reset();
+         /// creates the new empty histogram for sum
+         std::function<T *()> createEmpty;
+         /// adds values that are shared by all threads (see ThrObj::SetSharedAtomicBins) to the histogram; empty if there are none
+         std::function<void(T *)> addShared;
+         /// values moved in previous checkpoints and the ones added in Holder::Resume; they are merged in Write after per-thread copies
+         std::shared_ptr<T> sum;
+         /// threads that filled the histogram; std::deque is used so that references stay valid when threads are added
+         std::deque<Participant> participants;
+         /// mutex for participants and sum since threads are added from different threads
+         std::mutex mutex;
+      };
+
+      /*! @class Holder
+       * @brief Stores histograms of ThrObj objects, merges and writes them
+       *
+       * Every ThrObj is registered with one holder: the one passed to its constructor or the default one (see GetDefault). Holders share no state, hence independent sets of histograms can be filled and written concurrently (ROOT::EnableThreadSafety() must be called before histograms are created). Holder must outlive its ThrObj objects
        */
-      void Write(const std::string& outputFileName);
+      class Holder
+      {
+         public:
+         /// Default constructor
+         Holder() = default;
+         /// Destructor; waits for the checkpoint that is being written to be finished (see Checkpoint)
+         ~Holder();
+         /// Holder owns the histograms registered with it hence it can not be copied
+         Holder(const Holder&) = delete;
+         /// Holder owns the histograms registered with it hence it can not be copied
+         Holder& operator=(const Holder&) = delete;
+         /*! @brief Call this function to merge and write histograms of this holder in the current open TDirectory (i.e. gDirectory)
+          *
+          * Histograms are written directory by directory in the order of registration of directories and objects. Nested directories are separated by '/' (e.g. "det/sector3/pmt") and are created together with their parents. gDirectory is not changed
+          */
+         void Write();
+         /*! @brief Call this function to merge and write histograms of this holder in the specified file which will be overwritten if it already exists, otherwise it will be created
+          *
+          * Different holders can write into different files concurrently on different threads
+          *
+          * @param[in] outputFileName name of the output file
+          */
+         void Write(const std::string& outputFileName);
+         /*! @brief Same as Write(outputFileName) but histograms are merged and written in a background thread
+          *
+          * Histograms of this holder are handed over to the background thread together with its settings, after which this holder is empty and new histograms can be created and filled while the previous ones are written. ThrObj objects registered before the call must not be used after it. ROOT::EnableThreadSafety() is called by this function
+          *
+          * @param[in] outputFileName name of the output file
+          * @return future that becomes ready when the file is written and closed; it must be kept until then since its destructor waits for the write to be finished
+          */
+         std::future<void> WriteAsync(const std::string& outputFileName);
+         /*! @brief Sets the mode in which histograms are merged when Write is called
+          *
+          * In parallel mode histograms are distributed across the pool of threads and merged concurrently, after which they are written on the calling thread in the same order as in the serial mode. 
+          *
+          * @param[in] parallelMerge if true histograms will be merged in parallel, otherwise they will be merged one by one on the calling thread (default)
+          * @param[in] nThreads number of threads in the pool; if 0 is passed std::thread::hardware_concurrency() is used
+          * @param[in] treeReduction if true per-thread copies are reduced pairwise in a tree instead of one by one into the first copy; the order of the summation differs hence the result can differ in the last bits
+          */
+         void SetParallelMerge(const bool parallelMerge, const unsigned int nThreads = 0, 
+                               const bool treeReduction = false);
+         /*! @brief Sets the mode in which histograms are written when Write is called
+          *
+          * In streaming mode histograms are merged and written one by one without being cloned and per-thread copies of each histogram are freed right after it is written, hence peak memory stays at about one merged histogram above the memory used while filling
+          *
+          * @param[in] streamingWrite if true streaming mode is enabled, otherwise all histograms are merged before being written and are freed only after all of them were written (default)
+          */
+         void SetStreamingWrite(const bool streamingWrite);
+         /*! @brief Sets whether histograms are kept after they are written
+          *
+          * By default Write deletes all histograms of this holder. If histograms are reused Write keeps them registered together with their per-thread copies and resets the copies, hence the same ThrObj objects can be filled in the next run without allocations. Copies are then not freed in streaming mode
+          *
+          * @param[in] reuseHistograms if true histograms are kept and reset in Write, otherwise they are deleted (default)
+          */
+         void SetReuseHistograms(const bool reuseHistograms);
+         /*! @brief Sets whether bin arrays of per-thread copies of histograms are allocated in per-thread arenas
+          *
+          * In arena mode bin arrays of all copies of one thread are carved from large page-aligned blocks of this thread instead of separate heap allocations, hence they lie contiguously which speeds up the merge. Histograms in this mode must not be rebinned or have extendable axes. Must be called before histograms are filled
+          *
+          * @param[in] useArena if true arena mode is enabled, otherwise bin arrays are allocated by ROOT (default)
+          * @param[in] blockSize minimum size of each memory block of the arena in bytes
+          * @param[in] hugePages if true blocks are advised to be backed by transparent huge pages (Linux only) which reduces the number of TLB misses during the merge
+          */
+         void SetArena(const bool useArena, const std::size_t blockSize = 64*1024*1024, 
+                       const bool hugePages = false);
+         /*! @brief Sets whether per-thread copies of each histogram are merged per NUMA node
+          *
+          * In NUMA-aware mode copies of each histogram are grouped by NUMA nodes of their bins, each group is merged by a thread bound to the CPUs of its node, and results of groups are merged at the end, hence only one copy per node is read across nodes. The order of the summation differs hence the result can differ in the last bits. Supported only on Linux; elsewhere copies are merged as usual
+          *
+          * @param[in] numaAwareMerge if true NUMA-aware mode is enabled, otherwise it is disabled (default)
+          */
+         void SetNUMAAwareMerge(const bool numaAwareMerge);
+         /*! @brief Zeroes contents and statistics of all allocated per-thread copies of histograms of this holder in place
+          *
+          * Registrations and per-thread copies are kept and copies are reset in parallel (see SetParallelMerge). Values in storages of ThrObj are discarded and entries of trees of ThrTree are removed. Must not be called while histograms are filled
+          */
+         void Reset();
+         /*! @brief Writes the current state of histograms of this holder into the checkpoint file in a background thread
+          *
+          * Starts the new checkpoint epoch and writes the sum of all values in the background; returns right away and histograms can be filled meanwhile (see CheckpointValues). Values of threads that do not fill the histogram within gracePeriod seconds are included in later checkpoints and their number is printed; Write is always complete. ThrCounter, ThrCutflow, ThrTree, and copies filled through Get(slot) are not included. The file is written as checkpointFileName + ".tmp" and is renamed when it is complete. Histograms with extendable axes are not supported. Checkpoints must be enabled with SetCheckpoints. ROOT::EnableThreadSafety() is called by this function
+          *
+          * @param[in] checkpointFileName name of the file in which the checkpoint will be written
+          * @param[in] gracePeriod time in seconds for which the background thread waits for the snapshots of threads
+          * @return false if the previous checkpoint is still being written; in this case nothing is done
+          */
+         bool Checkpoint(const std::string& checkpointFileName, const double gracePeriod = 1.);
+         /*! @brief Adds contents of histograms from the checkpoint file (see Checkpoint) to the histograms of this holder
+          *
+          * Histograms are found by their directories and names. Contents of histograms of ThrObj are added to the sum of checkpoints and the ones of other objects to the copies of the calling thread. Must be called after all histograms were created and before they are filled
+          *
+          * @param[in] checkpointFileName name of the checkpoint file
+          */
+         void Resume(const std::string& checkpointFileName);
+         /*! @brief Returns projected peak memory in bytes taken by histograms of this holder if they are filled on nThreads threads and written
+          *
+          * Every histogram is assumed to get one copy per thread whose size is computed from its arrays of bins and sums of squares of weights, and twice the size of the largest copy is added for the buffers of Write. Trees of ThrTree are counted with the memory they already take; storages of ThrObj are not included. Nothing is allocated by this function
+          *
+          * @param[in] nThreads number of threads that fill histograms; if 0 is passed std::thread::hardware_concurrency() is used
+          */
+         std::size_t EstimateMemory(const unsigned int nThreads = 0);
+         /*! @brief Prints memory taken by histograms of this holder by types, by directories, and for the largest histograms together with its projection for nThreads threads (see EstimateMemory)
+          *
+          * For each group the number of histograms, bytes of one copy, the number of allocated copies, allocated bytes, and projected bytes are printed. Numbers are approximate if histograms are being filled
+          *
+          * @param[in] nThreads number of threads for the projection; if 0 is passed std::thread::hardware_concurrency() is used
+          * @param[in] nLargest number of the largest histograms that are printed
+          */
+         void Report(const unsigned int nThreads = 0, const std::size_t nLargest = 10);
+         /*! @brief Sets whether fills of histograms of this holder are counted and timed (see PrintFillStats)
+          *
+          * Only histograms created after this function was called with true register fill statistics. Fill counts values only in code compiled with ROOT_TOOLS_THR_OBJ_FILL_STATS defined (THR_OBJ_FILL_STATS option of CMake); FillN counts values in any case. Must be called before histograms are created
+          *
+          * @param[in] fillStats if true fill statistics are collected, otherwise they are not (default)
+          */
+         void SetFillStats(const bool fillStats);
+         /*! @brief Sets whether threads that fill histograms of ThrObj keep their values for checkpoints (see Checkpoint)
+          *
+          * If enabled every thread allocates the second copy of each histogram (or storage) it fills, hence memory of copies is doubled; if disabled Fill does not check for checkpoints. Must be called before histograms are filled
+          *
+          * @param[in] checkpoints if true checkpoints can be written, otherwise they can not (default)
+          */
+         void SetCheckpoints(const bool checkpoints);
+         /*! @brief Prints histograms ranked by the estimated time spent in their Fill and FillN calls, and histograms that were never filled
+          *
+          * Every thread counts values passed to Fill and FillN per histogram; FillN calls and every fillTimingPeriod-th Fill call are timed and the time of all fills is extrapolated from them. Called in Write before histograms are merged, after which statistics are reset
+          *
+          * @param[in] nRows number of the slowest histograms and of the never filled histograms that are printed
+          */
+         void PrintFillStats(const std::size_t nRows = 20);
+
+         // other functions and variables below are not intended for the user 
+         // and are called/accessed automaticaly
+
+         /*! @brief Not intended for user. Adds the object with nCells bins (including underflow and overflow bins) to the container of its type creating the container on the first object of this type; this function is called in ThrObj constructor
+          *
+          * Types that can be held are the ones for which this function is explicitly instantiated in ThrObj.cpp
+          */
+         template<typename T>
+         ROOT::TThreadedObject<T> *AddHistogram(ROOT::TThreadedObject<T> *hist,
+                                                const std::string& name,
+                                                const std::string& directory,
+                                                CheckpointValues<T> *values = nullptr,
+                                                const std::size_t nCells = 0);
+         /// Not intended for user. Adds storage to the corresponding container; this function is called by ThrObj when the storage is created
+         void AddFlushable(Flushable *flushable);
+         /// Not intended for user. Registers fill statistics of the histogram and returns them, or returns nullptr if fill statistics are not collected (see SetFillStats); this function is called in ThrObj constructor
+         FillCounters *AddFillCounters(const std::string& name, const std::string& directory);
+         /// Not intended for user. Adds the trees to the container of trees; this function is called in ThrTree constructor
+         void AddTree(ThreadTrees *trees, const std::string& directory);
+         /// Not intended for user. Shows whether arena mode is enabled (see SetArena)
+         bool IsArenaEnabled() const;
+         /// Not intended for user. Shows whether checkpoints are enabled (see SetCheckpoints)
+         bool AreCheckpointsEnabled() const;
+         /// Not intended for user. Returns zero-initialized memory of nBytes size from the arena of the calling thread; the arena is kept until the returned pointer and all of its copies are destroyed
+         std::shared_ptr<void> AllocateInArena(const std::size_t nBytes);
+         /// Not intended for user. Returns the epoch of the last checkpoint; threads that fill ThrObj switch sides when the epoch changes (see Checkpoint)
+         std::uint64_t GetCheckpointEpoch() const;
+         /// Not intended for user. Returns the smallest number of slots of TThreadedObject of the objects registered with the holder (i.e. the number of threads that can fill all of them) or 0 if no objects are registered
+         unsigned int GetNSlots();
 
-      // other functions and variables below are not intended for the user 
-      // and are called/accessed automaticaly
-
-      /// Not intended for user. Adds TH1F histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH1F> AddHistogram(ROOT::TThreadedObject<TH1F> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH2F histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH2F> AddHistogram(ROOT::TThreadedObject<TH2F> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH3F histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH3F> AddHistogram(ROOT::TThreadedObject<TH3F> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH1D histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH1D> AddHistogram(ROOT::TThreadedObject<TH1D> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH2D histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH2D> AddHistogram(ROOT::TThreadedObject<TH2D> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH3D histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH3D> AddHistogram(ROOT::TThreadedObject<TH3D> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH1L histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH1L> AddHistogram(ROOT::TThreadedObject<TH1L> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH2L histogram to the corresponding container; this function is called in ThrObj constructor
-      std::shared_ptr<TH2L> AddHistogram(ROOT::TThreadedObject<TH2L> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Adds TH3L histogram to the corresponding container; this function is called in ThrObj constructo
-      std::shared_ptr<TH3L> AddHistogram(ROOT::TThreadedObject<TH3L> *hist, 
-                                         const std::string& directory);
-      /// Not intended for user. Not intended for user. Clears containers with histogram after histograms were merged and written 
-      void Clear();
-      /// Not intended for user. Adds index of ThrObj to the directory index. This function is called in AddHistogram function
-      void AddTFileDirectory(const std::string& directory, const int thrObjIndex);
-
-      /// container for TH1F histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH1F>>> containerTH1F;
-      /// container for TH2F histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH2F>>> containerTH2F;
-      /// container for TH3F histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH3F>>> containerTH3F;
-      /// container for TH1D histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH1D>>> containerTH1D;
-      /// container for TH2D histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH2D>>> containerTH2D;
-      /// container for TH3D histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH3D>>> containerTH3D;
-      /// container for TH1L histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH1L>>> containerTH1L;
-      /// container for TH2L histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH2L>>> containerTH2L;
-      /// container for TH3L histograms
-      std::vector<std::unique_ptr<ROOT::TThreadedObject<TH3L>>> containerTH3L;
-
-      /// containers of TFile directory names
-      std::vector<std::string> containerTFileDir;
-      // indices of the TFile directories to the histograms
-      std::array<std::vector<int>, 9> containerTFileDirIndex;
+         protected:
+
+         /// Not intended for user. Memory taken by one object (see Report)
+         struct MemoryEntry
+         {
+            /// name of the class of the object
+            std::string type;
+            /// index of the directory of the object
+            std::size_t dirIndex;
+            /// name of the object
+            std::string name;
+            /// bytes taken by one copy of the object; 0 if no copies are allocated and the model was not sized
+            std::size_t bytesPerCopy;
+            /// number of allocated copies
+            std::size_t nCopies;
+            /// shows whether every thread gets its own copy of the same size; false for trees of ThrTree
+            bool isPerThread;
+         };
+         /// Not intended for user. Object of the checkpoint whose values are summed after registryMutex is released (see WriteCheckpoint)
+         struct Snapshot
+         {
+            /// index of the directory of the object
+            std::size_t dirIndex;
+            /// returns the sum of the values of the object (nullptr if it was not filled yet) and adds the number of threads whose values are missing from it to the passed counter
+            std::function<std::shared_ptr<TObject>(std::size_t&)> get;
+         };
+         /// Not intended for user. Base of containers of objects of one type; see Container
+         struct ContainerBase
+         {
+            virtual ~ContainerBase() = default;
+            /// Merges all objects in parallel if parallel merge is enabled and streaming write is not, otherwise objects are merged in Write; this function is called in Holder::Write function
+            virtual void Merge(Holder& holder) = 0;
+            /// Writes the object with histIndex index in the container into dir merging it if it was not merged yet; this function is called in Holder::Write function
+            virtual void Write(Holder& holder, const std::size_t histIndex, TDirectory *dir) = 0;
+            /// Adds functions that reset all allocated per-thread copies of objects to resets; this function is called in Holder::Reset function
+            virtual void AddResets(std::vector<std::function<void()>>& resets) = 0;
+            /// Adds the objects that are included in the checkpoint of the epoch to snapshots in the order of directories; threads are waited for until deadline. This function is called in WriteCheckpoint function
+            virtual void AddSnapshots(std::vector<Snapshot>& snapshots, const std::uint64_t epoch,
+                                      const std::chrono::steady_clock::time_point deadline) = 0;
+            /// Adds objects from the checkpoint file to the copies of objects of the calling thread; this function is called in Holder::Resume function
+            virtual void Resume(Holder& holder, TFile& checkpointFile) = 0;
+            /// Adds memory taken by every object to entries; if sizeModels is true objects that have no copies are sized by their numbers of bins (see GetModelSize). This function is called in EstimateMemory and Report functions
+            virtual void AddMemoryEntries(std::vector<MemoryEntry>& entries, const bool sizeModels) = 0;
+            /// indices of objects in the container (same order as in AddHistogram) for every directory index
+            std::vector<std::vector<std::size_t>> dirHists;
+            /// names of objects in the same order as in dirHists
+            std::vector<std::vector<std::string>> dirHistNames;
+         };
+         /// Not intended for user. Container of objects of type T together with the results of their merge
+         template<typename T>
+         struct Container : public ContainerBase
+         {
+            void Merge(Holder& holder) override;
+            void Write(Holder& holder, const std::size_t histIndex, TDirectory *dir) override;
+            void AddResets(std::vector<std::function<void()>>& resets) override;
+            void AddSnapshots(std::vector<Snapshot>& snapshots, const std::uint64_t epoch,
+                              const std::chrono::steady_clock::time_point deadline) override;
+            void Resume(Holder& holder, TFile& checkpointFile) override;
+            void AddMemoryEntries(std::vector<MemoryEntry>& entries, const bool sizeModels) override;
+            /// objects in the order of registration
+            std::vector<std::unique_ptr<ROOT::TThreadedObject<T>>> hists;
+            /// values of objects for checkpoints in the same order as hists; nullptr for objects that are not ThrObj (see CheckpointValues)
+            std::vector<std::unique_ptr<CheckpointValues<T>>> checkpointValues;
+            /// merged objects; empty pointers for objects that were not merged yet
+            std::vector<std::shared_ptr<T>> mergedHists;
+            /// numbers of bins of objects (including underflow and overflow bins) in the same order as hists
+            std::vector<std::size_t> nCells;
+         };
+         /// Not intended for user. Container of trees of ThrTree objects (see ThrTree)
+         struct TreeContainer : public ContainerBase
+         {
+            /// Writes the baskets of all per-thread trees into their files; trees are flushed in parallel if parallel merge is enabled
+            void Merge(Holder& holder) override;
+            /// Merges per-thread trees of the ThrTree by copying their compressed baskets into the tree in dir
+            void Write(Holder& holder, const std::size_t histIndex, TDirectory *dir) override;
+            void AddResets(std::vector<std::function<void()>>& resets) override;
+            /// Trees are filled and flushed by their threads during the checkpoint hence they are not included in it
+            void AddSnapshots(std::vector<Snapshot>& snapshots, const std::uint64_t epoch,
+                              const std::chrono::steady_clock::time_point deadline) override;
+            /// Entries of trees can not be added back hence nothing is read from the checkpoint file
+            void Resume(Holder& holder, TFile& checkpointFile) override;
+            /// Memory of each tree is the sum of sizes of its memory files
+            void AddMemoryEntries(std::vector<MemoryEntry>& entries, const bool sizeModels) override;
+            /// trees in the order of registration
+            std::vector<std::unique_ptr<ThreadTrees>> trees;
+         };
+
+         /// Not intended for user. Clears containers with histogram after histograms were merged and written 
+         void Clear();
+         /// Not intended for user. Registers the directory and adds the object with histIndex index in the container to the objects of this directory. This function is called in AddHistogram function
+         void AddTFileDirectory(const std::string& name, const std::string& directory, 
+                                ContainerBase& container, const std::size_t histIndex);
+         /// Not intended for user. Creates directories with dirNames names (see containerTFileDir) in outputDir and returns pointers to them by directory index; this function is called in Write and WriteCheckpoint functions
+         std::vector<TDirectory *> MakeDirectories(TDirectory *outputDir,
+                                                   const std::vector<std::string>& dirNames);
+         /// Not intended for user. Flushes all storages into histograms; this function is called in Write function
+         void FlushAll();
+         /// Not intended for user. Moves all histograms, directories, and storages of this holder into the holder and copies all settings of this holder to it; this function is called in WriteAsync function
+         void HandOver(Holder& holder);
+         /// Not intended for user. Waits for the checkpoint that is being written to be finished
+         void WaitCheckpoint();
+         /// Not intended for user. Writes sums of the values of all histograms that threads left when they switched to the epoch until deadline into the checkpoint file; this function is called in the background thread started in Checkpoint function
+         void WriteCheckpoint(const std::string& checkpointFileName, const std::uint64_t epoch,
+                              const std::chrono::steady_clock::time_point deadline);
+         /// Not intended for user. Returns memory taken by all objects in the order of containers and directories
+         std::vector<MemoryEntry> GetMemoryEntries(const bool sizeModels);
+         /// Not intended for user. Returns bytes that the object takes when it is filled on nThreads threads
+         static std::size_t GetProjectedBytes(const MemoryEntry& entry, const unsigned int nThreads);
+         /// Not intended for user. Calls func(i) for every i in [0, n) on the pool of Write (see ThreadPool) or, outside of Write, on the new pool of threads (see SetParallelMerge for the number of threads)
+         void RunOnPool(const std::size_t n, const std::function<void(const std::size_t)>& func);
+         /// Not intended for user. Merges per-thread copies of the histogram with their spare copies and the sum of checkpoints (values can be nullptr); copies are merged pairwise if treeReduction is true and on the pool of Write if nThreads is greater than 1
+         template<typename T>
+         std::shared_ptr<T> MergeSlots(ROOT::TThreadedObject<T> *hist, CheckpointValues<T> *values,
+                                       const unsigned int nThreads, const bool treeReduction);
+
+         /// containers of objects of all types in the order in which the first object of each type was added
+         std::vector<std::unique_ptr<ContainerBase>> containers;
+         /// indices of containers by the types of their objects
+         std::unordered_map<std::type_index, std::size_t> containerIndex;
+
+         /// container of TFile directory names in the order of registration; directory with index i has index i + 1 since index 0 is reserved for the directory in which histograms are written
+         std::vector<std::string> containerTFileDir;
+         /// indices of TFile directories by their names
+         std::unordered_map<std::string, std::size_t> tFileDirIndex;
+         /// objects of all types of every directory index in the order of registration as the container and the index of the object in it; objects are written in this order
+         std::vector<std::vector<std::pair<ContainerBase *, std::size_t>>> dirObjects;
+         /// smallest number of slots of TThreadedObject of the registered objects; 0 if no objects are registered
+         unsigned int nSlots = 0;
+         /// mutex for containers of histograms and directories since they are read by the checkpoint thread
+         std::mutex registryMutex;
+
+         /// container for storages that are flushed into histograms in Write (see Flushable)
+         std::vector<std::unique_ptr<Flushable>> containerFlushable;
+         /// fill statistics of histograms in the order of registration (see PrintFillStats); guarded by registryMutex
+         std::vector<std::unique_ptr<FillCounters>> containerFillCounters;
+         /// mutex for containerFlushable since storages are added from different threads
+         std::mutex flushableMutex;
+
+         /// shows whether histograms are merged in parallel (see SetParallelMerge)
+         bool parallelMerge = false;
+         /// number of threads used for parallel merge; 0 means std::thread::hardware_concurrency()
+         unsigned int mergeNThreads = 0;
+         /// shows whether per-thread copies are reduced pairwise in a tree during parallel merge
+         bool mergeTreeReduction = false;
+         /// shows whether histograms are written in streaming mode (see SetStreamingWrite)
+         bool streamingWrite = false;
+         /// shows whether histograms are kept and reset in Write (see SetReuseHistograms)
+         bool reuseHistograms = false;
+         /// shows whether fills are counted and timed (see SetFillStats)
+         bool fillStats = false;
+         /// shows whether threads keep their values for checkpoints (see SetCheckpoints)
+         bool checkpoints = false;
+         /// shows whether copies are merged per NUMA node (see SetNUMAAwareMerge)
+         bool numaAwareMerge = false;
+         /// shows whether bin arrays are allocated in arenas (see SetArena)
+         bool useArena = false;
+         /// minimum size of each memory block of arenas
+         std::size_t arenaBlockSize = 64*1024*1024;
+         /// shows whether memory blocks of arenas are advised to be backed by huge pages
+         bool arenaHugePages = false;
+         /// arenas of all threads that filled histograms in arena mode; they are owned by the copies carved from them
+         std::unordered_map<std::thread::id, std::weak_ptr<Arena>> containerArena;
+         /// mutex for containerArena since arenas are added from different threads
+         std::mutex arenaMutex;
+         /// threads on which the parallel steps of Write are run; exists only during Write in parallel mode
+         std::unique_ptr<ThreadPool> writePool;
+         /// background thread in which the checkpoint is written (see Checkpoint)
+         std::thread checkpointThread;
+         /// mutex for checkpointThread since checkpoints can be started and waited for from different threads
+         std::mutex checkpointMutex;
+         /// shows whether the checkpoint is being written
+         std::atomic<bool> isCheckpointRunning{false};
+         /// epoch of the last checkpoint; incremented by every call of Checkpoint
+         std::atomic<std::uint64_t> checkpointEpoch{0};
+      };
+
+      /// Returns the holder with which ThrObj objects are registered if no other holder was passed to their constructors; functions of this namespace call the same functions of this holder
+      Holder& GetDefault();
+      /// Calls Holder::Write() of the default holder (see GetDefault)
+      void Write();
+      /// Calls Holder::Write(outputFileName) of the default holder (see GetDefault)
+      void Write(const std::string& outputFileName);
+      /// Calls Holder::WriteAsync(outputFileName) of the default holder (see GetDefault)
+      std::future<void> WriteAsync(const std::string& outputFileName);
+      /// Calls Holder::SetParallelMerge of the default holder (see GetDefault)
+      void SetParallelMerge(const bool parallelMerge, const unsigned int nThreads = 0, 
+                            const bool treeReduction = false);
+      /// Calls Holder::SetStreamingWrite of the default holder (see GetDefault)
+      void SetStreamingWrite(const bool streamingWrite);
+      /// Calls Holder::SetReuseHistograms of the default holder (see GetDefault)
+      void SetReuseHistograms(const bool reuseHistograms);
+      /// Calls Holder::Reset of the default holder (see GetDefault)
+      void Reset();
+      /// Calls Holder::SetNUMAAwareMerge of the default holder (see GetDefault)
+      void SetNUMAAwareMerge(const bool numaAwareMerge);
+      /// Calls Holder::SetArena of the default holder (see GetDefault)
+      void SetArena(const bool useArena, const std::size_t blockSize = 64*1024*1024, 
+                    const bool hugePages = false);
+      /// Calls Holder::SetFillStats of the default holder (see GetDefault)
+      void SetFillStats(const bool fillStats);
+      /// Calls Holder::SetCheckpoints of the default holder (see GetDefault)
+      void SetCheckpoints(const bool checkpoints);
+      /// Calls Holder::EstimateMemory of the default holder (see GetDefault)
+      std::size_t EstimateMemory(const unsigned int nThreads = 0);
+      /// Calls Holder::Report of the default holder (see GetDefault)
+      void Report(const unsigned int nThreads = 0, const std::size_t nLargest = 10);
+      /// Not intended for user. Calls func(i) for every i in [0, n) on the pool of nThreads threads
+      void ParallelFor(const std::size_t n, unsigned int nThreads, 
+                       const std::function<void(const std::size_t)>& func);
+      /// Not intended for user. Returns the NUMA node on which the page with the address is placed or -1 if it is unknown
+      int GetNUMANode(const void *address);
+      /// Not intended for user. Returns CPUs of the NUMA node; the list is empty if they are unknown
+      std::vector<int> GetNUMANodeCPUs(const int node);
+      /// Not intended for user. Returns CPUs on which the calling thread is allowed to run; the list is empty if they are unknown
+      std::vector<int> GetCPUAffinity();
+      /// Not intended for user. Allows the calling thread to run only on the CPUs; returns false if the affinity was not changed (e.g. if the list is empty)
+      bool SetCPUAffinity(const std::vector<int>& cpus);
+      /// Not intended for user. Detaches the object from the directory into which it was read or cloned
+      void Detach(TH1 *hist);
+      /// Not intended for user. See Detach(TH1 *)
+      void Detach(TEfficiency *efficiency);
+      /// Not intended for user. See Detach(TH1 *)
+      template<typename V>
+      void Detach(TParameter<V> *) {}
+      /// Not intended for user. Adds the contents of source to target
+      void AddObject(TH1 *target, const TH1 *source);
+      /// Not intended for user. See AddObject(TH1 *, const TH1 *)
+      void AddObject(TEfficiency *target, const TEfficiency *source);
+      /// Not intended for user. See AddObject(TH1 *, const TH1 *)
+      template<typename V>
+      void AddObject(TParameter<V> *target, const TParameter<V> *source)
+      {
+         target->SetVal(target->GetVal() + source->GetVal());
+      }
+      /// Not intended for user. Zeroes the contents of the object without reallocating them
+      void ResetObject(TH1 *hist);
+      /// Not intended for user. See ResetObject(TH1 *)
+      void ResetObject(TEfficiency *efficiency);
+      /// Not intended for user. See ResetObject(TH1 *)
+      template<typename V>
+      void ResetObject(TParameter<V> *parameter)
+      {
+         parameter->SetVal(0);
+      }
+      /// Not intended for user. Returns the number of bytes taken by the histogram together with its arrays of bins
+      template<typename T>
+      std::size_t GetObjectSize(const T *hist)
+      {
+         using ContentType = std::remove_pointer_t<decltype(hist->GetArray())>;
+         std::size_t size = sizeof(T) + hist->GetNcells()*sizeof(ContentType) + 
+                            hist->GetSumw2N()*sizeof(Double_t);
+         // profiles also store numbers of entries of bins and sums of squares of weights of entries
+         if constexpr (std::is_base_of<TProfile, T>::value || std::is_base_of<TProfile2D, T>::value)
+         {
+            size += (hist->GetNcells() + hist->GetBinSumw2()->GetSize())*sizeof(Double_t);
+         }
+         return size;
+      }
+      /// Not intended for user. See GetObjectSize(const T *)
+      std::size_t GetObjectSize(const TEfficiency *efficiency);
+      /// Not intended for user. See GetObjectSize(const T *)
+      template<typename V>
+      std::size_t GetObjectSize(const TParameter<V> *)
+      {
+         return sizeof(TParameter<V>);
+      }
+      /// Not intended for user. Returns the number of bytes taken by the object of type T with nCells bins (including underflow and overflow bins) before it is filled; used to size objects that have no copies yet
+      template<typename T>
+      std::size_t GetModelSize(const std::size_t nCells)
+      {
+         if constexpr (std::is_base_of<TEfficiency, T>::value) 
+         {
+            return sizeof(TEfficiency) + 2*(sizeof(TH1D) + nCells*sizeof(Double_t));
+         }
+         else if constexpr (std::is_base_of<TH1, T>::value)
+         {
+            using ContentType = std::remove_pointer_t<decltype(std::declval<T&>().GetArray())>;
+            std::size_t size = sizeof(T) + nCells*sizeof(ContentType);
+            // profiles always have sums of squares and numbers of entries of bins
+            if constexpr (std::is_base_of<TProfile, T>::value || std::is_base_of<TProfile2D, T>::value)
+            {
+               size += 2*nCells*sizeof(Double_t);
+            }
+            else if (TH1::GetDefaultSumw2()) size += nCells*sizeof(Double_t);
+            return size;
+         }
+         else return sizeof(T);
+      }
+      /// Not intended for user. Returns the number of bytes in the human readable form (e.g. "1.50 GiB")
+      std::string FormatBytes(const double nBytes);
    };
 
    /*! @class ThrObj
     * @brief Class ThrObj can be used to simplify the work with TThreadedObject histograms in multithreaded applications
     *
-    * This class is especially useful when working with TTreeProcessorMT
+    * This class is especially useful when working with TTreeProcessorMT or ParallelEventLoop
+    *
+    * Besides histograms T can be TProfile, TProfile2D, or TEfficiency; for them only constructors, Get, and Fill are available
     *
     * Examples on usage will be added later
     */
@@ -107,7 +751,13 @@ namespace ROOTTools
    class ThrObj
    {
       public:
-      /*! @brief Constructor for TH1F, TH1D, and TH1L types
+      /// Number of dimensions of the histogram
+      static constexpr std::size_t nDim = 
+         std::is_base_of<TH3, T>::value ? 3 : (std::is_base_of<TH2, T>::value ? 2 : 1);
+      /// shows whether T is a histogram that supports all fill modes; false for profiles and TEfficiency
+      static constexpr bool isHistogram = std::is_base_of<TH1, T>::value && 
+         !std::is_base_of<TProfile, T>::value && !std::is_base_of<TProfile2D, T>::value;
+      /*! @brief Constructor for TH1F, TH1D, TH1L, TH1S, and TH1I types
        *
        * @param[in] name name of the histogram
        * @param[in] title title of the histogram
@@ -115,11 +765,13 @@ namespace ROOTTools
        * @param[in] xLow lower edge of the first bin on X axis
        * @param[in] xUp upper edge of the last bin on X axis
        * @param[in] fileDirectory directory in which histogram will be written. If it does not exist it will be created
+       * @param[in] holder holder with which histogram is registered and by which it will be written (see ThrObjHolder::Holder)
        */
       ThrObj(const std::string& name, const std::string& title,
              const int xNBins, const double xLow, const double xMax,
-             const std::string& fileDirectory = "");
-      /*! @brief Constructor for TH2F, TH2D, and TH2L types
+             const std::string& fileDirectory = "",
+             ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Constructor for TH2F, TH2D, TH2L, TH2S, and TH2I types
        *
        * @param[in] name name of the histogram
        * @param[in] title title of the histogram
@@ -130,12 +782,14 @@ namespace ROOTTools
        * @param[in] yLow lower edge of the first bin on Y axis
        * @param[in] yUp upper edge of the last bin on Y axis
        * @param[in] fileDirectory directory in which histogram will be written. If it does not exist it will be created
+       * @param[in] holder holder with which histogram is registered and by which it will be written (see ThrObjHolder::Holder)
        */
       ThrObj(const std::string& name, const std::string& title,
              const int xNBins, const double xLow, const double xMax, 
              const int yNBins, const double yMin, const double yMax,
-             const std::string& fileDirectory = "");
-      /*! @brief Constructor for TH3F, TH3D, and TH3L types
+             const std::string& fileDirectory = "",
+             ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Constructor for TH3F, TH3D, TH3L, TH3S, and TH3I types
        *
        * @param[in] name name of the histogram
        * @param[in] title title of the histogram
@@ -149,20 +803,969 @@ namespace ROOTTools
        * @param[in] zLow lower edge of the first bin on Z axis
        * @param[in] zUp upper edge of the last bin on Z axis
        * @param[in] fileDirectory directory in which histogram will be written. If it does not exist it will be created
+       * @param[in] holder holder with which histogram is registered and by which it will be written (see ThrObjHolder::Holder)
        */
       ThrObj(const std::string& name, const std::string& title,
              const int xNBins, const double xLow, const double xMax, 
              const int yNBins, const double yMin, const double yMax,
              const int zNBins, const double zMin, const double zMax,
-             const std::string& fileDirectory = "");
-      /*! @brief Returns shared pointer to the object
+             const std::string& fileDirectory = "",
+             ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Constructor with variable width bins for TH1F, TH1D, TH1L, TH1S, and TH1I types
        *
-       * This pointer is used to create one intance of TThreadedObject on a single thread for uninterrupted access to the object which makes writes safer and faster. Different instances from all threads can be merged after the process on each thread is finished
+       * Bins are found with the precomputed grid over each axis (see BinLookup) and Fill in the default mode adds values directly to the copy as StaticThrObj does, hence copies must not be rebinned or have extendable axes or the buffer. If there are less than 2 edges or they are not increasing the warning is printed and bins are found by T
+       *
+       * @param[in] name name of the histogram
+       * @param[in] title title of the histogram
+       * @param[in] xEdges low edges of the bins on X axis followed by the upper edge of the last bin; must be in increasing order
+       * @param[in] fileDirectory directory in which histogram will be written. If it does not exist it will be created
+       * @param[in] holder holder with which histogram is registered and by which it will be written (see ThrObjHolder::Holder)
+       */
+      ThrObj(const std::string& name, const std::string& title,
+             const std::vector<double>& xEdges,
+             const std::string& fileDirectory = "",
+             ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Constructor with variable width bins for TH2F, TH2D, TH2L, TH2S, and TH2I types
+       *
+       * See the constructor with variable width bins for 1D histograms for the details
+       *
+       * @param[in] name name of the histogram
+       * @param[in] title title of the histogram
+       * @param[in] xEdges low edges of the bins on X axis followed by the upper edge of the last bin; must be in increasing order
+       * @param[in] yEdges low edges of the bins on Y axis followed by the upper edge of the last bin; must be in increasing order
+       * @param[in] fileDirectory directory in which histogram will be written. If it does not exist it will be created
+       * @param[in] holder holder with which histogram is registered and by which it will be written (see ThrObjHolder::Holder)
+       */
+      ThrObj(const std::string& name, const std::string& title,
+             const std::vector<double>& xEdges, const std::vector<double>& yEdges,
+             const std::string& fileDirectory = "",
+             ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Constructor with variable width bins for TH3F, TH3D, TH3L, TH3S, and TH3I types
+       *
+       * See the constructor with variable width bins for 1D histograms for the details
+       *
+       * @param[in] name name of the histogram
+       * @param[in] title title of the histogram
+       * @param[in] xEdges low edges of the bins on X axis followed by the upper edge of the last bin; must be in increasing order
+       * @param[in] yEdges low edges of the bins on Y axis followed by the upper edge of the last bin; must be in increasing order
+       * @param[in] zEdges low edges of the bins on Z axis followed by the upper edge of the last bin; must be in increasing order
+       * @param[in] fileDirectory directory in which histogram will be written. If it does not exist it will be created
+       * @param[in] holder holder with which histogram is registered and by which it will be written (see ThrObjHolder::Holder)
+       */
+      ThrObj(const std::string& name, const std::string& title,
+             const std::vector<double>& xEdges, const std::vector<double>& yEdges,
+             const std::vector<double>& zEdges,
+             const std::string& fileDirectory = "",
+             ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Returns pointer to the copy of the object that belongs to the calling thread
+       *
+       * Every thread gets its own copy of the object from TThreadedObject that is allocated on the first call on this thread; copies are merged in Write of the holder. The pointer must not be used after Write and must not be kept across fills if checkpoints are enabled since the thread then switches between two copies
        */
       std::shared_ptr<T> Get();
+      /*! @brief Same as Get() but returns the raw pointer
+       *
+       * The pointer is cached in thread local storage after the first call on the thread. Use this function instead of Get() when the histogram is filled in hot loops
+       */
+      T *GetRaw();
+      /*! @brief Returns pointer to the copy of the object that belongs to the specified slot
+       *
+       * Can be used with slot callbacks of TTreeProcessorMT or RDataFrame where the slot is provided by ROOT. Should not be mixed with Get() for the same object since Get() assigns slots in the order of the first calls of threads
+       *
+       * @param[in] slot number of the slot; must be less than the number of slots of TThreadedObject (ROOT::GetThreadPoolSize() by default)
+       */
+      std::shared_ptr<T> Get(const unsigned int slot);
+      /*! @brief Fills the copy of the histogram of the calling thread with all passed values; for TH1F, TH1D, TH1L, TH1S, and TH1I types
+       *
+       * Bin indices are computed for blocks of values in a form that compiler vectorizes (or with BinLookup for histograms created with edges) and contents and statistics are accumulated in the same order as in T::Fill, hence the result is the same as the one of Fill for each value. Other variable width axes, extendable axes, axes with the set range, and histograms with the buffer fall back to Fill for each value. In storage modes values go to the storage; the fill buffer is bypassed
+       *
+       * @param[in] x values on X axis
+       * @param[in] w weights of the values; if empty every value is filled with the weight of 1, otherwise must have the same size as x
+       */
+      void FillN(std::span<const double> x, std::span<const double> w = {});
+      /*! @brief Fills the copy of the histogram of the calling thread with all passed values; for TH2F, TH2D, TH2L, TH2S, and TH2I types
+       *
+       * See FillN for 1D histograms for the details
+       *
+       * @param[in] x values on X axis
+       * @param[in] y values on Y axis; must have the same size as x
+       * @param[in] w weights of the values; if empty (i.e. {} is passed) every value is filled with the weight of 1, otherwise must have the same size as x
+       */
+      void FillN(std::span<const double> x, std::span<const double> y, 
+                 std::span<const double> w);
+      /*! @brief Fills the copy of the histogram of the calling thread with all passed values; for TH3F, TH3D, TH3L, TH3S, and TH3I types
+       *
+       * See FillN for 1D histograms for the details
+       *
+       * @param[in] x values on X axis
+       * @param[in] y values on Y axis; must have the same size as x
+       * @param[in] z values on Z axis; must have the same size as x
+       * @param[in] w weights of the values; if empty (i.e. {} is passed) every value is filled with the weight of 1, otherwise must have the same size as x
+       */
+      void FillN(std::span<const double> x, std::span<const double> y, 
+                 std::span<const double> z, std::span<const double> w);
+      /*! @brief Fills the copy of the histogram of the calling thread
+       *
+       * Arguments are the same as the ones of T::Fill: (x[, w]) for 1D, (x, y[, w]) for 2D, and (x, y, z[, w]) for 3D histograms. Values go to the fill buffer or to the storage of the fill mode if one is set (see SetFillBuffer, SetSharedAtomicBins, SetSparseBins, and SetCompactCounters); otherwise this is the same as Get()->Fill(...) except that bins of histograms created with edges are found with lookups
+       */
+      template<typename... Args>
+      void Fill(const Args... args)
+      {
+#ifdef ROOT_TOOLS_THR_OBJ_FILL_STATS
+         if (fillCounters) 
+         {
+            CountFill([&]() { FillImpl(args...); });
+            return;
+         }
+#endif
+         FillImpl(args...);
+      }
+      /*! @brief Enables or disables buffering of values passed to Fill
+       *
+       * Values passed to Fill are stored in the thread local buffer and are filled into the histogram with FillN when the buffer is full, which keeps bins of one histogram in cache while many histograms are filled in each event. Should be called before the histogram is filled. Cannot be combined with shared atomic bins or sparse modes
+       *
+       * @param[in] bufferSize number of values each thread buffers for this histogram; 0 (default) disables buffering
+       */
+      void SetFillBuffer(const std::size_t bufferSize);
+      /// Fills the values buffered on the calling thread into its copy of the histogram
+      void FlushFillBuffer();
+      /*! @brief Switches the histogram to the shared atomic bins mode; for TH1F, TH1D, TH1L, TH1S, and TH1I types
+       *
+       * In this mode values from all threads are filled into a single array of bins with relaxed atomic operations and statistics are accumulated per thread, hence memory does not grow with the number of threads and no merge is needed. Intended for small histograms (see bench/AtomicBinsBench.cpp). Must be called before the histogram is filled; extendable axes and the buffer are not supported
+       */
+      void SetSharedAtomicBins();
+      /*! @brief Switches the histogram to the sparse mode; for TH2F, TH2D, TH2L, TH2S, TH2I, TH3F, TH3D, TH3L, TH3S, and TH3I types
+       *
+       * In this mode values are filled into per-thread hash tables of bin index to content instead of per-thread copies, hence memory of each thread scales with the number of bins it filled. Tables are filled into the histogram in Write of the holder. Intended for histograms with many bins of which each thread fills a small fraction. Must be called before the histogram is filled; extendable axes and the buffer are not supported
+       */
+      void SetSparseBins();
+      /*! @brief Switches the histogram to the compact counters mode
+       *
+       * In this mode unit weight fills are counted in per-thread arrays of 16-bit counters that are promoted to 32 bits on overflow instead of per-thread copies; other weights are filled into the copy of the calling thread. Counters are added to the histogram in Write of the holder. Intended for histograms filled with counts of entries. Must be called before the histogram is filled; extendable axes and the buffer are not supported
+       */
+      void SetCompactCounters();
+      protected:
+      /// Fills the values into the copy of the histogram or into the storage of the current fill mode; see Fill
+      template<typename... Args>
+      void FillImpl(const Args... args)
+      {
+         if constexpr (!isHistogram) GetRaw()->Fill(args...);
+         else
+         {
+            static_assert(sizeof...(Args) == nDim || sizeof...(Args) == nDim + 1, 
+                          "ThrObj<T>::Fill takes coordinates and optionally weight");
+            if (fillMode == FillMode::Direct) 
+            {
+               // bins on variable width axes are found with the lookups instead of the binary search 
+               // done by T::Fill
+               if (!binLookups) GetRaw()->Fill(static_cast<double>(args)...);
+               else if constexpr (sizeof...(Args) == nDim) 
+               {
+                  LookupFill({static_cast<double>(args)..., 1.});
+               }
+               else LookupFill({static_cast<double>(args)...});
+               return;
+            }
+            if constexpr (sizeof...(Args) == nDim) StorageFill({static_cast<double>(args)..., 1.});
+            else StorageFill({static_cast<double>(args)...});
+         }
+      }
+      /// Calls fill counting one value in the counter of the calling thread and timing every ThrObjHolder::fillTimingPeriod-th call
+      template<typename Func>
+      void CountFill(const Func& fill)
+      {
+         ThrObjHolder::FillCounter& counter = GetFillCounter();
+         counter.nFills++;
+         if (counter.untilTimed-- != 0)
+         {
+            fill();
+            return;
+         }
+         counter.untilTimed = ThrObjHolder::fillTimingPeriod - 1;
+         const auto start = std::chrono::steady_clock::now();
+         fill();
+         const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+         counter.timedSeconds += duration.count();
+         counter.nTimedFills++;
+      }
+      /// Returns the fill counter of the calling thread creating it on the first call
+      ThrObjHolder::FillCounter& GetFillCounter();
+      /// Fill statistics of all threads; nullptr if fill statistics are not collected. Owned by ThrObjHolder
+      ThrObjHolder::FillCounters *fillCounters;
+      /// Constructor with the parameters of all axes in arrays; used by StaticThrObj
+      ThrObj(const std::string& name, const std::string& title,
+             const std::array<int, nDim>& nBins, const std::array<double, nDim>& low, 
+             const std::array<double, nDim>& up, const std::string& fileDirectory,
+             ThrObjHolder::Holder& holder);
+      /// Type of the bin content of the histogram; double for TEfficiency which is not used since TEfficiency is filled only directly
+      using ContentType = std::remove_reference_t<decltype(*std::declval<
+         std::conditional_t<std::is_base_of<TH1, T>::value, T, TH1D>>().GetArray())>;
+      /// shows whether 16 and 32 bit integer bin contents are saturated on overflow in T::AddBinContent
+      static constexpr bool isSaturated = 
+         std::is_integral<ContentType>::value && sizeof(ContentType) < sizeof(Long64_t);
+      /// Adds the value to the bin in the array of contents of the histogram; saturated contents (see isSaturated) are added through T::AddBinContent so that they are the same as after T::Fill
+      template<typename V>
+      static void AddBinContent(T *hist, ContentType *contents, const int bin, const V value)
+      {
+         if constexpr (isSaturated) hist->AddBinContent(bin, static_cast<double>(value));
+         else contents[bin] += static_cast<ContentType>(value);
+      }
+      /*! @brief Finds bins on the variable width axis in O(1)
+       *
+       * The axis is split into the uniform grid of cells not wider than the narrowest bin (their number is limited) and the bin of the low edge of each cell is precomputed, hence the bin of the value is found with one or a few comparisons
+       */
+      struct BinLookup
+      {
+         /// Constructor; edges are the low edges of the bins followed by the upper edge of the last bin. If there are less than 2 edges or they are not in increasing order the lookup is left empty with nBins equal to 0
+         BinLookup(const std::vector<double>& edges);
+         /// Returns the same bin as TAxis::FindFixBin (including underflow and overflow bins)
+         int FindBin(const double x) const;
+         /// Edges of the bins
+         std::vector<double> edges;
+         /// Bins that contain low edges of the cells of the grid
+         std::vector<int> cellBins;
+         /// Number of bins
+         int nBins;
+         /// Number of cells divided by the width of the axis
+         double cellScale;
+      };
+      /// Lookups of all axes; shared by ThrObj and its storages since storages may outlive it
+      using BinLookups = std::shared_ptr<const std::array<BinLookup, nDim>>;
+      /// Returns the shared lookups or nullptr if any of them is empty, in which case bins are found by T and TAxis on all axes
+      static BinLookups MakeBinLookups(const std::array<BinLookup, nDim>& lookups);
+      /// Modes in which values passed to Fill are stored
+      enum class FillMode 
+      {
+         Direct, ///< directly in the copy of the histogram of the calling thread
+         Buffered, ///< in the thread local fill buffer (see SetFillBuffer)
+         SharedAtomic, ///< in the bins shared by all threads (see SetSharedAtomicBins)
+         Sparse, ///< in the thread local hash table (see SetSparseBins)
+         Compact ///< in the thread local 16-bit counters (see SetCompactCounters)
+      };
+      /// Creates the copy of the histogram in the slot of the calling thread whose bin array is in the arena of the calling thread and returns it (see ThrObjHolder::Holder::SetArena)
+      T *CreateArenaSlot(const unsigned int slot);
+      /// Sets the mode checking that it is not combined with another mode that is not Direct
+      void SetFillMode(const FillMode mode);
+      /// Thread local structure-of-arrays buffer of values passed to Fill
+      struct FillBuffer : public ThrObjHolder::Flushable
+      {
+         FillBuffer(T *hist, const std::size_t bufferSize, const BinLookups& binLookups);
+         void Flush() override;
+         void Reset() override;
+         /// Copy of the histogram of the thread that owns the buffer
+         T *hist;
+         /// Buffered coordinates on each axis
+         std::array<std::vector<double>, nDim> coords;
+         /// Buffered weights
+         std::vector<double> w;
+         /// Number of buffered values
+         std::size_t size = 0;
+         /// Lookups of bins on variable width axes; nullptr for fixed width axes
+         BinLookups binLookups;
+      };
+      /// Bins of the histogram that are shared by all threads (see SetSharedAtomicBins)
+      struct AtomicBins : public ThrObjHolder::Flushable
+      {
+         /// Type in which bin contents are accumulated; saturated contents (see isSaturated) are accumulated in 64 bits so that they are saturated only when they are added to the histogram
+         using ContentType = std::conditional_t<isSaturated, Long64_t, ThrObj::ContentType>;
+         /// Statistics of one thread; aligned so that different threads never write to the same cache line
+         struct alignas(64) Stats
+         {
+            double sumw = 0., sumw2 = 0., sumwx = 0., sumwx2 = 0., entries = 0.;
+            /// shows whether weight that is not 1 was filled
+            bool isWeighted = false;
+         };
+         AtomicBins(T *hist, const BinLookups& binLookups);
+         void Flush() override;
+         void Reset() override;
+         /// Fills the value; can be called from any thread
+         void Fill(Stats& threadStats, const double x, const double w);
+         /// Adds statistics for the calling thread; this function is called on the first fill on each thread
+         Stats& AddStats();
+         /// Adds statistics of one thread to target; bins are added separately with AddBinsTo
+         static void AddStatsTo(T *target, const Stats& threadStats);
+         /// Adds the current contents of the bins to target without resetting them; bins can be filled meanwhile
+         void AddBinsTo(T *target) const;
+         /// Histogram into which the bins are flushed
+         T *hist;
+         /// Copy of the X axis of the histogram used to find bins
+         TAxis axis;
+         /// Lookups of bins on variable width axes; nullptr for fixed width axes
+         BinLookups binLookups;
+         /// shows whether fills in underflow and overflow bins are counted in statistics
+         bool statOverflows;
+         /// Contents of the bins
+         std::unique_ptr<std::atomic<ContentType>[]> contents;
+         /// Sums of squares of weights in the bins
+         std::unique_ptr<std::atomic<double>[]> sumw2;
+         /// Statistics of all threads; std::deque is used so that references stay valid when statistics are added
+         std::deque<Stats> stats;
+         /// mutex for stats since they are added from different threads
+         std::mutex statsMutex;
+      };
+      /// Sparse storage of the bins of the histogram (see SetSparseBins)
+      struct SparseBins : public ThrObjHolder::Flushable
+      {
+         /// Type in which bin contents are accumulated; saturated contents (see isSaturated) are accumulated in 64 bits so that they are saturated only when they are added to the histogram
+         using ContentType = std::conditional_t<isSaturated, Long64_t, ThrObj::ContentType>;
+         /// Content of one non-empty bin
+         struct Entry
+         {
+            /// global bin index; -1 for empty entries of the table
+            int bin = -1;
+            ContentType content = 0;
+            double sumw2 = 0.;
+         };
+         /// Open-addressing hash table with linear probing of one thread together with its statistics
+         struct Table
+         {
+            Table();
+            /// Returns the entry of the bin inserting it if it is not in the table
+            Entry& operator[](const int bin);
+            /// Doubles the capacity of the table
+            void Grow();
+            /// Entries; the size is always a power of 2
+            std::vector<Entry> entries;
+            /// Number of non-empty entries
+            std::size_t size = 0;
+            /// Statistics in the same format as TH1::GetStats
+            double stats[TH1::kNstat] = {};
+            /// Number of filled values
+            double nEntries = 0.;
+            /// shows whether weight that is not 1 was filled
+            bool isWeighted = false;
+         };
+         SparseBins(T *hist, const BinLookups& binLookups);
+         void Flush() override;
+         void Reset() override;
+         /// Fills the coordinates and the weight (the last element) into the table of the calling thread
+         void Fill(Table& table, const std::array<double, nDim + 1>& values);
+         /// Adds the table for the calling thread; this function is called on the first fill on each thread
+         Table& AddTable();
+         /// Adds contents and statistics of the tables to target
+         static void AddTablesTo(T *target, const std::vector<const Table *>& addedTables);
+         /// Histogram into which the tables are flushed
+         T *hist;
+         /// Copies of the axes of the histogram used to find bins
+         std::array<TAxis, nDim> axes;
+         /// Lookups of bins on variable width axes; nullptr for fixed width axes
+         BinLookups binLookups;
+         /// shows whether fills in underflow and overflow bins are counted in statistics
+         bool statOverflows;
+         /// Tables of all threads; std::deque is used so that references stay valid when tables are added
+         std::deque<Table> tables;
+         /// mutex for tables since they are added from different threads
+         std::mutex tablesMutex;
+      };
+      /// Per-thread 16-bit counters of unit weight fills that are promoted to 32 bits on overflow (see SetCompactCounters)
+      struct CompactBins : public ThrObjHolder::Flushable
+      {
+         /// Counters and statistics of one thread
+         struct Counters
+         {
+            /// Zeroes counters and statistics
+            void Reset();
+            /// 16-bit counters of all bins; released when counters are promoted
+            std::vector<std::uint16_t> counts16;
+            /// 32-bit counters of all bins; allocated only when a 16-bit counter would overflow
+            std::vector<std::uint32_t> counts32;
+            /// Statistics in the same format as TH1::GetStats
+            double stats[TH1::kNstat] = {};
+            /// Number of filled values
+            double nEntries = 0.;
+         };
+         CompactBins(T *hist, const BinLookups& binLookups);
+         void Flush() override;
+         void Reset() override;
+         /*! @brief Counts the coordinates (the weight, which is the last element, must be 1) in the counters of the calling thread
+          * @return global bin whose 32-bit counter overflowed (it is then set to 1 and UINT32_MAX must be added to this bin of the copy) or -1
+          */
+         int Fill(Counters& threadCounters, const std::array<double, nDim + 1>& values);
+         /// Adds the counters for the calling thread; this function is called on the first fill on each thread
+         Counters& AddCounters();
+         /// Adds contents and statistics of the counters to target
+         void AddCountersTo(T *target, const std::vector<const Counters *>& addedCounters) const;
+         /// Histogram into which the counters are flushed
+         T *hist;
+         /// Copies of the axes of the histogram used to find bins
+         std::array<TAxis, nDim> axes;
+         /// Lookups of bins on variable width axes; nullptr for fixed width axes
+         BinLookups binLookups;
+         /// Number of bins including underflow and overflow bins
+         int nCells;
+         /// shows whether fills in underflow and overflow bins are counted in statistics
+         bool statOverflows;
+         /// Counters of all threads; std::deque is used so that references stay valid when counters are added
+         std::deque<Counters> counters;
+         /// mutex for counters since they are added from different threads
+         std::mutex countersMutex;
+      };
+      /// Statistics of the values filled directly into the copy of the histogram of one thread (see BinFill) that are added to it in Write of the holder
+      struct DirectStats : public ThrObjHolder::Flushable
+      {
+         DirectStats(T *hist) : hist(hist) {}
+         void Flush() override
+         {
+            double histStats[TH1::kNstat] = {};
+            hist->GetStats(histStats);
+            for (int i = 0; i < TH1::kNstat; i++) histStats[i] += stats[i];
+            hist->PutStats(histStats);
+            hist->SetEntries(hist->GetEntries() + nEntries);
+            Reset();
+         }
+         void Reset() override
+         {
+            std::fill(stats, stats + TH1::kNstat, 0.);
+            nEntries = 0.;
+         }
+         /// Copy of the histogram of the thread that is filled
+         T *hist;
+         /// Statistics in the same format as TH1::GetStats
+         double stats[TH1::kNstat] = {};
+         /// Number of filled values
+         double nEntries = 0.;
+      };
+      /// Pointers to the objects of the calling thread that are cached in thread local storage
+      struct ThreadCache
+      {
+         /// id of the object to which the entry belongs (see ThrObjHolder::CacheIndex); 0 for entries that were never used
+         std::uint64_t id = 0;
+         /// Copy of the histogram of the calling thread
+         T *hist = nullptr;
+         /// Slot of the copy of the histogram of the calling thread in TThreadedObject
+         unsigned int slot = 0;
+         /// Fill buffer of the calling thread; created on the first buffered fill
+         FillBuffer *buffer = nullptr;
+         /// Statistics of the calling thread in the shared atomic bins mode; created on the first fill
+         typename AtomicBins::Stats *atomicStats = nullptr;
+         /// Hash table of the calling thread in the sparse mode; created on the first fill
+         typename SparseBins::Table *sparseTable = nullptr;
+         /// Counters of the calling thread in the compact counters mode; created on the first fill
+         typename CompactBins::Counters *compactCounters = nullptr;
+         /// Statistics of the values filled directly by the calling thread; created on the first fill
+         DirectStats *directStats = nullptr;
+         /// Objects of the calling thread that are filled after the next switch of sides (see SwitchSides); created together with the ones above if checkpoints are enabled
+         struct
+         {
+            T *hist = nullptr;
+            typename AtomicBins::Stats *atomicStats = nullptr;
+            typename SparseBins::Table *sparseTable = nullptr;
+            typename CompactBins::Counters *compactCounters = nullptr;
+         } spare;
+         /// Objects of the calling thread for checkpoints; nullptr if checkpoints are disabled or the thread did not fill yet
+         typename ThrObjHolder::CheckpointValues<T>::Participant *participant = nullptr;
+         /// Checkpoint epoch in which the thread switched sides last time
+         std::uint64_t epoch = 0;
+         /// Fill counter of the calling thread; created on the first fill if fill statistics are collected
+         ThrObjHolder::FillCounter *fillCounter = nullptr;
+      };
+      /// Returns the cache of the calling thread for this object; the thread switches sides if the new checkpoint was started
+      ThreadCache& GetThreadCache();
+      /// Adds the object of the calling thread that is filled (current) and its second side (spare) to the objects included in checkpoints; moveValues adds the values of one side to the histogram and empties the side
+      template<typename Object>
+      void Participate(ThreadCache& cache, Object *current, Object *spare,
+                       const std::function<void(T *, Object *)>& moveValues,
+                       const std::shared_ptr<T>& spareHist = nullptr);
+      /// Flushes the fill buffer and the statistics of the direct fills of the calling thread and makes it fill the other side of its objects (see ThrObjHolder::CheckpointValues)
+      void SwitchSides(ThreadCache& cache);
+      /// Returns the statistics of the values filled directly by the calling thread creating them on the first call
+      DirectStats& GetDirectStats()
+      {
+         ThreadCache& cache = GetThreadCache();
+         if (!cache.directStats)
+         {
+            cache.directStats = new DirectStats(GetRaw());
+            holder->AddFlushable(cache.directStats);
+         }
+         return *cache.directStats;
+      }
+      /*! @brief Fills the coordinates and the weight (the last element) into the bin directly in the array of contents of the copy of the histogram of the calling thread in the same order as T::Fill does it
+       *
+       * Statistics and the number of entries are accumulated in DirectStats; isInRange is false for underflow and overflow bins on any axis
+       */
+      void BinFill(const std::array<double, nDim + 1>& values, const int bin, const bool isInRange)
+      {
+         DirectStats& threadStats = GetDirectStats();
+         T *hist = threadStats.hist;
+
+         const double w = values[nDim];
+         // same as in TH1::Fill: the array of sum of squares of weights is created 
+         // on the first weight that is not 1
+         if (w != 1. && hist->GetSumw2N() == 0 && !hist->TestBit(TH1::kIsNotW)) hist->Sumw2();
+
+         AddBinContent(hist, hist->GetArray(), bin, w);
+         if (hist->GetSumw2N() > 0) hist->GetSumw2()->GetArray()[bin] += w*w;
+
+         threadStats.nEntries++;
+         if (!isInRange && !hist->GetStatOverflowsBehaviour()) return;
+
+         const double x = values[0];
+         threadStats.stats[0] += w;
+         threadStats.stats[1] += w*w;
+         threadStats.stats[2] += w*x;
+         threadStats.stats[3] += w*x*x;
+         if constexpr (nDim > 1)
+         {
+            const double y = values[1];
+            threadStats.stats[4] += w*y;
+            threadStats.stats[5] += w*y*y;
+            threadStats.stats[6] += w*x*y;
+            if constexpr (nDim > 2)
+            {
+               const double z = values[2];
+               threadStats.stats[7] += w*z;
+               threadStats.stats[8] += w*z*z;
+               threadStats.stats[9] += w*x*z;
+               threadStats.stats[10] += w*y*z;
+            }
+         }
+      }
+      /// Fills the coordinates and the weight (the last element) into the bins found with the lookups (see BinFill); used by Fill in the default mode for histograms with lookups
+      void LookupFill(const std::array<double, nDim + 1>& values)
+      {
+         int bin = 0;
+         bool isInRange = true;
+         for (int i = static_cast<int>(nDim) - 1; i >= 0; i--)
+         {
+            const BinLookup& lookup = (*binLookups)[i];
+            const int axisBin = lookup.FindBin(values[i]);
+            bin = bin*(lookup.nBins + 2) + axisBin;
+            isInRange = isInRange && axisBin != 0 && axisBin <= lookup.nBins;
+         }
+         BinFill(values, bin, isInRange);
+      }
+      /// Stores the coordinates and the weight (the last element) in the storage of the current fill mode
+      void StorageFill(const std::array<double, nDim + 1>& values);
+      /// Current fill mode
+      FillMode fillMode = FillMode::Direct;
+      /// Number of values each thread buffers in the Buffered mode
+      std::size_t fillBufferSize = 0;
+      /// Shared atomic bins in the SharedAtomic mode. Owned by ThrObjHolder
+      AtomicBins *atomicBins = nullptr;
+      /// Sparse bins in the Sparse mode. Owned by ThrObjHolder
+      SparseBins *sparseBins = nullptr;
+      /// Counters in the Compact mode. Owned by ThrObjHolder
+      CompactBins *compactBins = nullptr;
+      /// Number of values for which bin indices are computed at once in FillN
+      static constexpr std::size_t fillNBlockSize = 64;
+      /// Implementation of FillN; checks the sizes of the arrays and fills them in the storage of the current fill mode
+      void FillNImpl(const std::array<std::span<const double>, nDim>& coords, 
+                     std::span<const double> w);
+      /// Fills the values in the passed copy of the histogram; this function is called by FillN and when the fill buffer is flushed
+      static void FillHistN(T *hist, const std::array<std::span<const double>, nDim>& coords, 
+                            std::span<const double> w, const BinLookups& binLookups);
+      /*! @brief Computes the bin indices of fillNBlockSize values on the fixed width axis the same way TAxis::FindBin does it (including underflow and overflow bins)
+       *
+       * The number of values is a compile-time constant so that the loop can be vectorized
+       */
+      static void FindFixedBins(const double *x, const int nBins, 
+                                const double xMin, const double xMax, int *bins);
+      /// Lookups of bins on variable width axes; nullptr for histograms with fixed width axes
+      BinLookups binLookups;
+      /// Pointer to the TThreadedObject; it is owned by the holder
+      ROOT::TThreadedObject<T> *thrObj;
+      /// holder with which the histogram is registered
+      ThrObjHolder::Holder *holder;
+      /// Values of all threads for checkpoints. Owned by ThrObjHolder
+      ThrObjHolder::CheckpointValues<T> *checkpointValues;
+      /// Index of this object in the thread local caches
+      ThrObjHolder::CacheIndex cacheIndex;
+      /// Next slot of TThreadedObject that is not taken by any thread (see GetRaw); shared by copies of this object since they fill the same TThreadedObject
+      std::shared_ptr<std::atomic<unsigned int>> nextSlot = std::make_shared<std::atomic<unsigned int>>(0);
+      /// Returns indices of all ThrObj<T> objects in the thread local caches
+      static ThrObjHolder::CacheIndices& GetCacheIndices();
+   };
+
+   /*! @brief Axis with fixed width bins whose parameters are known at compile time; can be passed to StaticThrObj
+    *
+    * Edges are passed as fractions since floating point template parameters are not supported in C++17, e.g. StaticAxis<100, -5, 5, 10> has 100 bins from -0.5 to 0.5
+    */
+   template<int NBins, long Low, long Up, long Denominator = 1>
+   struct StaticAxis
+   {
+      static_assert(NBins > 0 && Low < Up && Denominator > 0, 
+                    "StaticAxis must have bins and increasing edges");
+      /// Number of bins
+      static constexpr int nBins = NBins;
+      /// Lower edge of the first bin
+      static constexpr double min = static_cast<double>(Low)/Denominator;
+      /// Upper edge of the last bin
+      static constexpr double max = static_cast<double>(Up)/Denominator;
+   };
+
+   /*! @class StaticThrObj
+    * @brief ThrObj whose axes are known at compile time
+    *
+    * In the default fill mode Fill finds the bins with the compile-time parameters of the axes (see StaticAxis) and adds values directly to the contents of the copy of the calling thread, hence the whole fill is inlined. Statistics are accumulated per thread and added in Write of the holder. Values closer to the edges than the rounding error may end up in the neighboring bin compared to T::Fill. Other functions and fill modes are the ones of ThrObj
+    *
+    * Example: StaticThrObj<TH2F, StaticAxis<100, 0, 10>, StaticAxis<64, -32, 32>> hist("hist", "hist");
+    */
+   template<typename T, typename... Axes>
+   class StaticThrObj : public ThrObj<T>
+   {
+      public:
+      /// Number of dimensions of the histogram
+      static constexpr std::size_t nDim = ThrObj<T>::nDim;
+      static_assert(sizeof...(Axes) == nDim, 
+                    "StaticThrObj<T, Axes...> takes one axis per dimension of T");
+      /*! @brief Constructor
+       *
+       * @param[in] name name of the histogram
+       * @param[in] title title of the histogram
+       * @param[in] fileDirectory directory in which histogram will be written. If it does not exist it will be created
+       * @param[in] holder holder with which histogram is registered and by which it will be written (see ThrObjHolder::Holder)
+       */
+      StaticThrObj(const std::string& name, const std::string& title,
+                   const std::string& fileDirectory = "",
+                   ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault()) :
+         ThrObj<T>(name, title, std::array<int, nDim>{Axes::nBins...}, 
+                   std::array<double, nDim>{Axes::min...}, std::array<double, nDim>{Axes::max...}, 
+                   fileDirectory, holder) {}
+      /*! @brief Fills the copy of the histogram of the calling thread
+       *
+       * Arguments are the same as the ones of T::Fill: (x[, w]) for 1D, (x, y[, w]) for 2D, and (x, y, z[, w]) for 3D histograms
+       */
+      template<typename... Args>
+      void Fill(const Args... args)
+      {
+#ifdef ROOT_TOOLS_THR_OBJ_FILL_STATS
+         if (this->fillCounters) 
+         {
+            this->CountFill([&]() { StaticFill(args...); });
+            return;
+         }
+#endif
+         StaticFill(args...);
+      }
+      protected:
+      /// Fills the values directly in the default fill mode or with ThrObj otherwise; see Fill
+      template<typename... Args>
+      void StaticFill(const Args... args)
+      {
+         static_assert(sizeof...(Args) == nDim || sizeof...(Args) == nDim + 1, 
+                       "StaticThrObj<T, Axes...>::Fill takes coordinates and optionally weight");
+         if (this->fillMode != ThrObj<T>::FillMode::Direct)
+         {
+            this->FillImpl(args...);
+            return;
+         }
+         if constexpr (sizeof...(Args) == nDim) DirectFill({static_cast<double>(args)..., 1.});
+         else DirectFill({static_cast<double>(args)...});
+      }
+      /// Fills the coordinates and the weight (the last element) into the bins found with the compile-time constant parameters of the axes
+      void DirectFill(const std::array<double, nDim + 1>& values)
+      {
+         int bin = 0;
+         bool isInRange = true;
+         for (int i = static_cast<int>(nDim) - 1; i >= 0; i--)
+         {
+            // same order of comparisons as in TAxis::FindFixBin so that NaN ends up in the overflow bin
+            int axisBin;
+            if (values[i] < min[i]) axisBin = 0;
+            else if (!(values[i] < max[i])) axisBin = nBins[i] + 1;
+            else axisBin = 1 + static_cast<int>((values[i] - min[i])*scale[i]);
+            bin = bin*(nBins[i] + 2) + axisBin;
+            isInRange = isInRange && axisBin != 0 && axisBin <= nBins[i];
+         }
+         this->BinFill(values, bin, isInRange);
+      }
+      /// Numbers of bins of the axes
+      static constexpr std::array<int, nDim> nBins = {Axes::nBins...};
+      /// Lower edges of the axes
+      static constexpr std::array<double, nDim> min = {Axes::min...};
+      /// Upper edges of the axes
+      static constexpr std::array<double, nDim> max = {Axes::max...};
+      /// Reciprocals of the widths of the bins
+      static constexpr std::array<double, nDim> scale = {Axes::nBins/(Axes::max - Axes::min)...};
+   };
+
+   /*! @class ThrCounter
+    * @brief Counter or sum that is incremented from many threads without contention and is written as TParameter<V>
+    *
+    * Every thread adds values to its own slot that takes a whole cache line, hence threads never write to the same cache line. Slots are added in Write of the holder and written as TParameter<V>. Values are not included in checkpoints. Must not be used after Write of its holder unless histograms are reused (see ThrObjHolder::Holder::SetReuseHistograms)
+    */
+   template<typename V = Long64_t>
+   class ThrCounter
+   {
+      public:
+      /*! @brief Constructor
+       *
+       * @param[in] name name of the counter
+       * @param[in] fileDirectory directory in which the counter will be written. If it does not exist it will be created
+       * @param[in] holder holder with which the counter is registered and by which it will be written (see ThrObjHolder::Holder)
+       */
+      ThrCounter(const std::string& name, const std::string& fileDirectory = "",
+                 ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /// Adds the value to the slot of the calling thread
+      void Add(const V value = 1) 
+      {
+         GetSlot().value += value;
+      }
+      protected:
+      /// Value of one thread; aligned so that different threads never write to the same cache line
+      struct alignas(64) Slot
+      {
+         V value = 0;
+      };
+      /// Slots of all threads that are added to the parameter in Write of the holder
+      struct Slots : public ThrObjHolder::Flushable
+      {
+         Slots(ROOT::TThreadedObject<TParameter<V>> *parameter);
+         void Flush() override;
+         void Reset() override;
+         /// Adds the slot for the calling thread; this function is called on the first Add on each thread
+         Slot& AddSlot();
+         /// Parameter to which slots are added
+         ROOT::TThreadedObject<TParameter<V>> *parameter;
+         /// Slots of all threads; std::deque is used so that references stay valid when slots are added
+         std::deque<Slot> slots;
+         /// mutex for slots since they are added from different threads
+         std::mutex slotsMutex;
+      };
+      /// Returns the slot of the calling thread creating it on the first call
+      Slot& GetSlot();
+      /// Slots of all threads. Owned by ThrObjHolder
+      Slots *slots;
+      /// Index of this object in the thread local cache of pointers to slots
+      ThrObjHolder::CacheIndex cacheIndex;
+      /// Returns indices of all ThrCounter<V> objects in the thread local caches
+      static ThrObjHolder::CacheIndices& GetCacheIndices();
+   };
+
+   /// ThrCounter that sums weights
+   using ThrSum = ThrCounter<double>;
+
+   /*! @class ThrCutflow
+    * @brief Table of numbers (or sums of weights) of events that passed each cut which is filled from many threads without contention and is written as TH1D
+    *
+    * Every thread counts events in its own cache line aligned array of sums of weights. Arrays are added in Write of the holder and written as TH1D whose bin i + 1 has the label and the sum of weights of cut i. Values are not included in checkpoints. Must not be used after Write of its holder unless histograms are reused (see ThrObjHolder::Holder::SetReuseHistograms)
+    */
+   class ThrCutflow
+   {
+      public:
+      /*! @brief Constructor
+       *
+       * @param[in] name name of the cutflow
+       * @param[in] cutNames names of the cuts which become the labels of the bins
+       * @param[in] fileDirectory directory in which the cutflow will be written. If it does not exist it will be created
+       * @param[in] holder holder with which the cutflow is registered and by which it will be written (see ThrObjHolder::Holder)
+       */
+      ThrCutflow(const std::string& name, const std::vector<std::string>& cutNames,
+                 const std::string& fileDirectory = "",
+                 ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Counts the event that passed the cut in the array of the calling thread
+       *
+       * @param[in] cut index of the cut in the list passed to the constructor; must be less than the number of cuts
+       * @param[in] weight weight of the event
+       */
+      void Pass(const std::size_t cut, const double weight = 1.)
+      {
+         if (cut >= table->cutNames.size()) ExitOutOfRange(cut);
+         Counts& counts = GetCounts();
+         counts.sumw[cut] += weight;
+         counts.sumw2[cut] += weight*weight;
+         counts.nEntries++;
+         if (weight != 1.) counts.isWeighted = true;
+      }
+      protected:
+      /// One cache line of values
+      struct alignas(64) CacheLine
+      {
+         double values[64/sizeof(double)] = {};
+      };
+      /// Sums of one thread; aligned so that the number of entries of different threads is never in the same cache line
+      struct alignas(64) Counts
+      {
+         /// Lines in which sums of weights and then sums of squares of weights are stored; the whole lines belong to one thread
+         std::vector<CacheLine> lines;
+         /// Sums of weights of the cuts
+         double *sumw;
+         /// Sums of squares of weights of the cuts
+         double *sumw2;
+         /// Number of counted events
+         double nEntries = 0.;
+         /// shows whether weight that is not 1 was counted
+         bool isWeighted = false;
+      };
+      /// Counts of all threads that are added to the histogram in Write of the holder
+      struct Table : public ThrObjHolder::Flushable
+      {
+         Table(ROOT::TThreadedObject<TH1D> *hist, const std::vector<std::string>& cutNames);
+         void Flush() override;
+         void Reset() override;
+         /// Adds the counts for the calling thread; this function is called on the first Pass on each thread
+         Counts& AddCounts();
+         /// Histogram to which counts are added
+         ROOT::TThreadedObject<TH1D> *hist;
+         /// Names of the cuts
+         std::vector<std::string> cutNames;
+         /// Counts of all threads; std::deque is used so that references stay valid when counts are added
+         std::deque<Counts> counts;
+         /// mutex for counts since they are added from different threads
+         std::mutex countsMutex;
+      };
+      /// Returns the counts of the calling thread creating them on the first call
+      Counts& GetCounts();
+      /// Prints the error about the cut that is out of range and exits; kept out of line so that Pass stays small
+      [[noreturn]] void ExitOutOfRange(const std::size_t cut) const;
+      /// Counts of all threads. Owned by ThrObjHolder
+      Table *table;
+      /// Index of this object in the thread local cache of pointers to counts
+      ThrObjHolder::CacheIndex cacheIndex;
+      /// Returns indices of all ThrCutflow objects in the thread local caches
+      static ThrObjHolder::CacheIndices& GetCacheIndices();
+   };
+
+   /*! @class ThrTree
+    * @brief TTree that is filled from many threads without locks and is written together with histograms of its holder
+    *
+    * Every thread fills its own tree attached to its own TMemFile, hence baskets are compressed by the thread that fills them. In Write of the holder trees of all threads are merged by copying their compressed baskets (see TTree::MergeTrees with "fast" option). Compressed entries are kept in memory until Write. Trees are not included in checkpoints. Must not be used after Write of its holder unless histograms are reused, in which case entries are removed in Write
+    */
+   class ThrTree
+   {
+      public:
+      /*! @brief Constructor
+       *
+       * @param[in] name name of the tree
+       * @param[in] title title of the tree
+       * @param[in] fileDirectory directory in which the tree will be written. If it does not exist it will be created
+       * @param[in] holder holder with which the tree is registered and by which it will be written (see ThrObjHolder::Holder)
+       */
+      ThrTree(const std::string& name, const std::string& title, 
+              const std::string& fileDirectory = "",
+              ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Returns the tree of the calling thread creating it on the first call
+       *
+       * Branches must be created on the tree of each thread before it is filled with the same names and types on all threads (e.g. with addresses of variables of this thread). gDirectory is not changed by this function
+       */
+      TTree *Get();
+      /// Fills the tree of the calling thread
+      Int_t Fill()
+      {
+         return Get()->Fill();
+      }
+      protected:
+      /// Trees of all threads. Owned by ThrObjHolder
+      ThrObjHolder::ThreadTrees *trees;
+      /// Index of this object in the thread local cache of pointers to trees
+      ThrObjHolder::CacheIndex cacheIndex;
+      /// Returns indices of all ThrTree objects in the thread local caches
+      static ThrObjHolder::CacheIndices& GetCacheIndices();
+   };
+
+   /*! @class ParallelEventLoop
+    * @brief Processes entries of the tree from many files on the pool of threads and writes histograms of the holder when all entries are processed
+    *
+    * Entries of every file are split into tasks by the clusters of the tree and tasks are dealt to threads in contiguous blocks with about the same number of entries. Every thread takes tasks from its own queue and steals them from the back of other queues when its queue is empty. The pool of threads is started on the first Run and reused. Time of each task is recorded (see GetTimings and PrintTimings)
+    */
+   class ParallelEventLoop
+   {
+      public:
+      /// Time of processing of one task
+      struct ClusterTiming
+      {
+         /// index of the file in the list of files
+         std::size_t file;
+         /// first entry of the task
+         Long64_t first;
+         /// entry after the last one of the task
+         Long64_t last;
+         /// index of the queue of the thread that processed the task; all tasks with the same index were processed by one thread
+         unsigned int thread;
+         /// time of processing in seconds
+         double seconds;
+      };
+      /*! @brief Constructor
+       *
+       * @param[in] treeName name of the tree in the files
+       * @param[in] fileNames names of the files
+       * @param[in] nThreads number of threads in the pool; if 0 is passed ROOT::GetThreadPoolSize() is used, or std::thread::hardware_concurrency() if implicit multithreading is not enabled
+       * @param[in] holder holder which histograms are written at the end of Run (see ThrObjHolder::Holder)
+       */
+      ParallelEventLoop(const std::string& treeName, const std::vector<std::string>& fileNames, 
+                        const unsigned int nThreads = 0,
+                        ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Constructor; files and the names of the trees are taken from the elements of the chain
+       *
+       * Each file is read with the name of the tree of its own element hence chains of trees with different names are processed correctly
+       *
+       * @param[in] chain chain of the trees; it is not read by the event loop
+       * @param[in] nThreads number of threads in the pool; see the other constructor
+       * @param[in] holder holder which histograms are written at the end of Run (see ThrObjHolder::Holder)
+       */
+      ParallelEventLoop(TChain& chain, const unsigned int nThreads = 0,
+                        ThrObjHolder::Holder& holder = ThrObjHolder::GetDefault());
+      /*! @brief Sets the minimum number of entries of each task
+       *
+       * Consecutive clusters of the same file are joined into one task until it has at least this number of entries. This reduces the overhead of creating TTreeReader for trees with small clusters
+       *
+       * @param[in] minTaskEntries minimum number of entries of each task; if 0 is passed (default) every cluster is a separate task
+       */
+      void SetMinTaskEntries(const Long64_t minTaskEntries);
+      /*! @brief Processes all entries and writes histograms of the holder into the output file
+       *
+       * ROOT::EnableThreadSafety() is called by this function. If a file or a tree cannot be read or nThreads exceeds the number of slots of histograms of the holder the error is printed and the program exits
+       *
+       * @param[in] func function that is called for every task; the entry range of the reader is already set to the task hence the function must create TTreeReaderValue objects for the reader and loop with TTreeReader::Next()
+       * @param[in] outputFileName name of the file into which histograms of the holder are written after all entries are processed (see ThrObjHolder::Holder::Write); if empty histograms are not written
+       */
+      void Run(const std::function<void(TTreeReader&)>& func, const std::string& outputFileName = "");
+      /// Returns timings of all tasks of the last Run ordered by files and entries
+      const std::vector<ClusterTiming>& GetTimings() const;
+      /// Prints the time spent by each thread, the spread of times of tasks, and the slowest tasks of the last Run
+      void PrintTimings(const std::size_t nSlowest = 5) const;
       protected:
-      /// Pointer to the TThreadedObject
-      std::shared_ptr<T> objPtr;
+      /// Range of entries of one file
+      struct Task
+      {
+         /// index of the file in the list of files
+         std::size_t file;
+         /// first entry
+         Long64_t first;
+         /// entry after the last one
+         Long64_t last;
+      };
+      /// Tasks of one thread
+      struct Queue
+      {
+         /// tasks that were not taken yet; the owner takes them from the front and others steal from the back
+         std::deque<Task> tasks;
+         /// mutex for tasks since they can be stolen by other threads
+         std::mutex mutex;
+      };
+      /// Reads cluster boundaries of the trees of all files (in parallel) and returns tasks in the order of files and entries; prints the error and exits if a file or a tree cannot be read
+      std::vector<Task> MakeTasks();
+      /// First error of the threads; worker threads record it instead of exiting so that it is reported once on the calling thread after they are joined
+      struct Error
+      {
+         /// Records the message if no error was recorded yet
+         void Set(const std::string& message);
+         /// Returns true if an error was recorded
+         bool IsSet() const;
+         /// Prints the error and exits if it was recorded
+         void Report();
+         /// message of the first error
+         std::string message;
+         /// flag checked by threads to stop early
+         std::atomic<bool> isSet{false};
+         /// mutex for message
+         std::mutex mutex;
+      };
+      /// Takes the task from the queue of the thread or steals it from the other queues; returns false if there are no tasks left
+      static bool TakeTask(std::vector<Queue>& queues, const unsigned int thread, Task& task);
+      /// Names of the trees in each file
+      std::vector<std::string> treeNames;
+      /// Names of the files
+      std::vector<std::string> fileNames;
+      /// Number of threads in the pool
+      unsigned int nThreads;
+      /// Threads on which tasks are processed; started on the first Run
+      std::unique_ptr<ThrObjHolder::ThreadPool> pool;
+      /// Minimum number of entries of each task (see SetMinTaskEntries)
+      Long64_t minTaskEntries = 0;
+      /// Holder which histograms are written at the end of Run
+      ThrObjHolder::Holder& holder;
+      /// Timings of all tasks of the last Run
+      std::vector<ClusterTiming> timings;
    };
 };
 
@@ -0,0 +1,252 @@
+/**
+ *  @file   ThrFileMerger.cpp
+ *  @brief  Contains functions that merge many ROOT files with the same layout (e.g. the ones written by ThrObjHolder in parallel jobs) on multiple threads
+ *
+ *  In order to use these functions libThrFileMerger.so must be loaded
+ *
+ *  This file is a part of a project ROOTTools (https://github.com/Sergeyir/ROOTTools).
+ *
+ *  @author Sergei Antsupov (antsupov0124@gmail.com)
+ **/
+#ifndef ROOT_TOOLS_THR_FILE_MERGER_CPP
+#define ROOT_TOOLS_THR_FILE_MERGER_CPP
+
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "TClass.h"
+
+#include "ThrFileMerger.hpp"
+
+void ROOTTools::ThrFileMerger::Merge(const std::string& outputFileName,
+                                     const std::vector<std::string>& inputFileNames,
+                                     unsigned int nThreads, const std::size_t maxObjectsInFlight)
+{
+   if (inputFileNames.size() == 0)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m No input files were passed to "
+                   "ROOTTools::ThrFileMerger::Merge" << std::endl;
+      exit(1);
+   }
+
+   if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+   // every thread needs at least one file
+   if (nThreads > inputFileNames.size()) nThreads = inputFileNames.size();
+   const std::size_t batchSize = std::max<std::size_t>(maxObjectsInFlight, 1);
+
+   ROOT::EnableThreadSafety();
+
+   // every file is opened once and after that it is read only by the thread to which it belongs
+   std::vector<std::unique_ptr<TFile>> inputFiles(inputFileNames.size());
+   ParallelFor(inputFileNames.size(), nThreads, [&](const std::size_t i)
+   {
+      inputFiles[i].reset(TFile::Open(inputFileNames[i].c_str(), "READ"));
+      if (!inputFiles[i] || inputFiles[i]->IsZombie())
+      {
+         std::cout << "\033[1m\033[31mError:\033[0m File " << inputFileNames[i] <<
+                      " could not be opened in ROOTTools::ThrFileMerger::Merge" << std::endl;
+         exit(1);
+      }
+   });
+
+   std::vector<std::string> dirs;
+   std::vector<Key> keys;
+   ReadLayout(inputFiles.front().get(), "", dirs, keys);
+
+   TFile outputFile(outputFileName.c_str(), "RECREATE");
+   if (outputFile.IsZombie())
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m File " << outputFileName <<
+                   " could not be created in ROOTTools::ThrFileMerger::Merge" << std::endl;
+      exit(1);
+   }
+   outputFile.SetCompressionSettings(inputFiles.front()->GetCompressionSettings());
+
+   // objects are written through the pointers to directories hence gDirectory is never changed
+   std::unordered_map<std::string, TDirectory *> outputDirs{{"", &outputFile}};
+   for (const std::string& dirName : dirs)
+   {
+      TDirectory *dir = outputFile.mkdir(dirName.c_str(), "", true);
+      if (!dir)
+      {
+         std::cout << "\033[1m\033[31mError:\033[0m Directory \"" << dirName <<
+                      "\" could not be created in " << outputFileName << std::endl;
+         exit(1);
+      }
+      outputDirs[dirName] = dir;
+   }
+
+   std::vector<Key> objectKeys;
+   std::vector<Key> treeKeys;
+   for (const Key& key : keys)
+   {
+      if (key.isTree) treeKeys.push_back(key);
+      else objectKeys.push_back(key);
+   }
+
+   for (std::size_t begin = 0; begin < objectKeys.size(); begin += batchSize)
+   {
+      const std::size_t end = std::min(begin + batchSize, objectKeys.size());
+
+      // partial sums of the objects of the batch for every thread
+      std::vector<std::vector<TObject *>> partials(end - begin,
+                                                   std::vector<TObject *>(nThreads, nullptr));
+
+      ParallelFor(nThreads, nThreads, [&](const std::size_t thread)
+      {
+         const std::size_t firstFile = thread*inputFiles.size()/nThreads;
+         const std::size_t lastFile = (thread + 1)*inputFiles.size()/nThreads;
+         for (std::size_t i = begin; i < end; i++)
+         {
+            TObject *&partial = partials[i - begin][thread];
+            for (std::size_t j = firstFile; j < lastFile; j++)
+            {
+               TObject *obj = ReadObject(inputFiles[j].get(), objectKeys[i]);
+               if (!obj) continue;
+               if (!partial)
+               {
+                  partial = obj;
+                  continue;
+               }
+               // objects that can not be merged are taken from the first file
+               MergeObject(partial, obj);
+               delete obj;
+            }
+         }
+      });
+
+      // on each level partial sum i + stride is merged into partial sum i
+      // for every i that is a multiple of 2*stride
+      for (std::size_t stride = 1; stride < nThreads; stride *= 2)
+      {
+         const std::size_t nPairs = (nThreads + stride - 1)/(2*stride);
+         ParallelFor((end - begin)*nPairs, nThreads, [&](const std::size_t i)
+         {
+            std::vector<TObject *>& objPartials = partials[i/nPairs];
+            TObject *&target = objPartials[2*stride*(i % nPairs)];
+            TObject *&source = objPartials[2*stride*(i % nPairs) + stride];
+            if (!source) return;
+            if (target)
+            {
+               MergeObject(target, source);
+               delete source;
+            }
+            else target = source;
+            source = nullptr;
+         });
+      }
+
+      // objects are written on the calling thread in the order of the layout
+      for (std::size_t i = begin; i < end; i++)
+      {
+         TObject *merged = partials[i - begin].front();
+         if (!merged) continue;
+         outputDirs[objectKeys[i].dir]->WriteTObject(merged, objectKeys[i].name.c_str());
+         delete merged;
+      }
+   }
+
+   // trees are written into the output file while they are merged hence they are merged one by one
+   for (const Key& key : treeKeys)
+   {
+      const std::string path = (key.dir == "") ? key.name : key.dir + "/" + key.name;
+
+      // merged tree is created in its directory; gDirectory is restored when context is destroyed
+      TDirectory::TContext context(outputDirs[key.dir]);
+      std::unique_ptr<TTree> mergedTree;
+      for (std::unique_ptr<TFile>& inputFile : inputFiles)
+      {
+         std::unique_ptr<TTree> tree(inputFile->Get<TTree>(path.c_str()));
+         if (!tree) continue;
+         // compressed baskets are copied as they are
+         if (!mergedTree) mergedTree.reset(tree->CloneTree(-1, "fast"));
+         else mergedTree->CopyEntries(tree.get(), -1, "fast");
+      }
+      if (mergedTree) mergedTree->Write("", TObject::kOverwrite);
+   }
+
+   outputFile.Close();
+}
+
+void ROOTTools::ThrFileMerger::ReadLayout(TDirectory *dir, const std::string& path,
+                                          std::vector<std::string>& dirs, std::vector<Key>& keys)
+{
+   // the same name appears once for every cycle of the object
+   std::unordered_set<std::string> names;
+
+   TIter nextKey(dir->GetListOfKeys());
+   while (TKey *key = static_cast<TKey *>(nextKey()))
+   {
+      const std::string name = key->GetName();
+      if (!names.insert(name).second) continue;
+
+      const std::string keyPath = (path == "") ? name : path + "/" + name;
+
+      TClass *keyClass = TClass::GetClass(key->GetClassName());
+      if (!keyClass)
+      {
+         std::cout << "\033[1m\033[35mWarning:\033[0m Class " << key->GetClassName() << " of " <<
+                      keyPath << " is unknown; it will not be merged" << std::endl;
+         continue;
+      }
+
+      if (keyClass->InheritsFrom("TDirectory"))
+      {
+         dirs.push_back(keyPath);
+         ReadLayout(dir->GetDirectory(name.c_str()), keyPath, dirs, keys);
+      }
+      else keys.push_back({path, name, keyClass->InheritsFrom("TTree")});
+   }
+}
+
+TObject *ROOTTools::ThrFileMerger::ReadObject(TFile *file, const Key& key)
+{
+   const std::string path = (key.dir == "") ? key.name : key.dir + "/" + key.name;
+   TObject *obj = file->Get(path.c_str());
+   if (!obj) return nullptr;
+
+   // histograms are attached to the directory from which they are read
+   ROOT::DirAutoAdd_t autoAdd = obj->IsA()->GetDirectoryAutoAdd();
+   if (autoAdd) autoAdd(obj, nullptr);
+   return obj;
+}
+
+bool ROOTTools::ThrFileMerger::MergeObject(TObject *target, TObject *source)
+{
+   ROOT::MergeFunc_t merge = target->IsA()->GetMerge();
+   if (!merge) return false;
+
+   TList list;
+   list.Add(source);
+   merge(target, &list, nullptr);
+   return true;
+}
+
+void ROOTTools::ThrFileMerger::ParallelFor(const std::size_t n, unsigned int nThreads,
+                                           const std::function<void(const std::size_t)>& func)
+{
+   if (nThreads > n) nThreads = n;
+
+   if (nThreads <= 1)
+   {
+      for (std::size_t i = 0; i < n; i++) func(i);
+      return;
+   }
+
+   // indices are handed out one by one so that threads that got cheap objects
+   // pick up the remaining ones instead of idling
+   std::atomic<std::size_t> nextIndex(0);
+   std::vector<std::thread> pool;
+   for (unsigned int i = 0; i < nThreads; i++)
+   {
+      pool.emplace_back([&]()
+      {
+         for (std::size_t j = nextIndex++; j < n; j = nextIndex++) func(j);
+      });
+   }
+   for (std::thread& thr : pool) thr.join();
+}
+
+#endif /* ROOT_TOOLS_THR_FILE_MERGER_CPP */
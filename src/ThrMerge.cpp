@@ -0,0 +1,54 @@
+/**
+ *  @file   ThrMerge.cpp
+ *  @brief  Executable that merges many ROOT files with the same layout on multiple threads (see ThrFileMerger.hpp)
+ *
+ *  Usage: ThrMerge [-j nThreads] [-n maxObjectsInFlight] output.root input1.root input2.root ...
+ *
+ *  This file is a part of a project ROOTTools (https://github.com/Sergeyir/ROOTTools).
+ *
+ *  @author Sergei Antsupov (antsupov0124@gmail.com)
+ **/
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ThrFileMerger.hpp"
+
+int main(int argc, char **argv)
+{
+   unsigned int nThreads = 0;
+   std::size_t maxObjectsInFlight = 64;
+   std::vector<std::string> fileNames;
+
+   for (int i = 1; i < argc; i++)
+   {
+      const std::string arg = argv[i];
+      if (arg == "-j" || arg == "-n")
+      {
+         const std::string value = (i + 1 < argc) ? argv[++i] : "";
+         if (value == "" || value.find_first_not_of("0123456789") != std::string::npos)
+         {
+            std::cout << "\033[1m\033[31mError:\033[0m Option " << arg <<
+                         " requires a non-negative integer" << std::endl;
+            return 1;
+         }
+         if (arg == "-j") nThreads = std::stoul(value);
+         else maxObjectsInFlight = std::stoul(value);
+      }
+      else fileNames.push_back(arg);
+   }
+
+   if (fileNames.size() < 2)
+   {
+      std::cout << "Usage: ThrMerge [-j nThreads] [-n maxObjectsInFlight] "\
+                   "output.root input1.root input2.root ..." << std::endl;
+      std::cout << "   -j number of threads; 0 means the number of hardware threads (default)" << std::endl;
+      std::cout << "   -n number of objects that are merged at once (default 64)" << std::endl;
+      return 1;
+   }
+
+   ROOTTools::ThrFileMerger::Merge(fileNames.front(),
+                                   std::vector<std::string>(fileNames.begin() + 1, fileNames.end()),
+                                   nThreads, maxObjectsInFlight);
+   return 0;
+}
@@ -11,302 +11,3542 @@
 #ifndef ROOT_TOOLS_THR_OBJ_CPP
 #define ROOT_TOOLS_THR_OBJ_CPP
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
 #include <vector>
 #include <array>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <type_traits>
+#include <future>
+#include <chrono>
+#include <deque>
+#include <tuple>
+#include <iomanip>
 
+#include "TROOT.h"
 #include "TFile.h"
+#include "TList.h"
 #include "TH1.h"
 #include "TH2.h"
 #include "TH3.h"
+#include "TTree.h"
+#include "TMemFile.h"
+#include "TChain.h"
+#include "TTreeReader.h"
 
 #include "ROOT/TThreadedObject.hxx"
+#include "ROOT/RSpan.hxx"
 
 #include "ThrObj.hpp"
 
-std::shared_ptr<TH1F> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH1F> *hist, 
-                                                            const std::string& directory) 
+template<typename T>
+ROOT::TThreadedObject<T> *ROOTTools::ThrObjHolder::Holder::AddHistogram(ROOT::TThreadedObject<T> *hist, 
+                                                                        const std::string& name, 
+                                                                        const std::string& directory,
+                                                                        CheckpointValues<T> *values,
+                                                                        const std::size_t nCells) 
+{
+   std::lock_guard<std::mutex> lock(registryMutex);
+
+   auto index = containerIndex.find(std::type_index(typeid(T)));
+   if (index == containerIndex.end())
+   {
+      containers.emplace_back(new Container<T>());
+      index = containerIndex.emplace(std::type_index(typeid(T)), containers.size() - 1).first;
+   }
+   Container<T>& container = static_cast<Container<T>&>(*containers[index->second]);
+
+   container.hists.emplace_back(hist);
+   container.checkpointValues.emplace_back(values);
+   container.nCells.push_back(nCells);
+   if (nSlots == 0 || hist->GetNSlots() < nSlots) nSlots = hist->GetNSlots();
+   AddTFileDirectory(name, directory, container, container.hists.size() - 1);
+   return hist;
+}
+
+void ROOTTools::ThrObjHolder::Holder::Clear()
+{
+   containers.clear();
+   containerIndex.clear();
+
+   containerFlushable.clear();
+   containerFillCounters.clear();
+   // arenas were freed together with the copies of histograms deleted above
+   containerArena.clear();
+
+   containerTFileDir.clear();
+   tFileDirIndex.clear();
+   dirObjects.clear();
+   nSlots = 0;
+}
+
+void ROOTTools::ThrObjHolder::Holder::AddFlushable(Flushable *flushable)
 {
-   containerTH1F.emplace_back(hist);
-   AddTFileDirectory(directory, 0);
-   return containerTH1F.back()->Get();
-};
+   std::lock_guard<std::mutex> lock(flushableMutex);
+   containerFlushable.emplace_back(flushable);
+}
 
-std::shared_ptr<TH2F> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH2F> *hist, 
-                                                            const std::string& directory)
+void ROOTTools::ThrObjHolder::Holder::AddTree(ThreadTrees *trees, const std::string& directory)
 {
-   containerTH2F.emplace_back(hist);
-   AddTFileDirectory(directory, 1);
-   return containerTH2F.back()->Get();
-};
+   std::lock_guard<std::mutex> lock(registryMutex);
+
+   auto index = containerIndex.find(std::type_index(typeid(TTree)));
+   if (index == containerIndex.end())
+   {
+      containers.emplace_back(new TreeContainer());
+      index = containerIndex.emplace(std::type_index(typeid(TTree)), containers.size() - 1).first;
+   }
+   TreeContainer& container = static_cast<TreeContainer&>(*containers[index->second]);
 
-std::shared_ptr<TH3F> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH3F> *hist, 
-                                                            const std::string& directory) 
+   container.trees.emplace_back(trees);
+   AddTFileDirectory(trees->name, directory, container, container.trees.size() - 1);
+}
+
+ROOTTools::ThrObjHolder::FillCounters *
+ROOTTools::ThrObjHolder::Holder::AddFillCounters(const std::string& name, const std::string& directory)
 {
-   containerTH3F.emplace_back(hist);
-   AddTFileDirectory(directory, 2);
-   return containerTH3F.back()->Get();
-};
+   if (!fillStats) return nullptr;
+   std::lock_guard<std::mutex> lock(registryMutex);
+   containerFillCounters.emplace_back(new FillCounters(name, directory));
+   return containerFillCounters.back().get();
+}
+
+ROOTTools::ThrObjHolder::FillCounters::FillCounters(const std::string& name, 
+                                                    const std::string& directory) : 
+   name(name), directory(directory) {}
 
-std::shared_ptr<TH1D> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH1D> *hist, 
-                                                            const std::string& directory) 
+ROOTTools::ThrObjHolder::FillCounter& ROOTTools::ThrObjHolder::FillCounters::AddCounter()
 {
-   containerTH1D.emplace_back(hist);
-   AddTFileDirectory(directory, 3);
-   return containerTH1D.back()->Get();
-};
+   std::lock_guard<std::mutex> lock(countersMutex);
+   return counters.emplace_back();
+}
 
-std::shared_ptr<TH2D> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH2D> *hist, 
-                                                            const std::string& directory) 
+std::pair<std::size_t, std::uint64_t> ROOTTools::ThrObjHolder::CacheIndices::Acquire()
 {
-   containerTH2D.emplace_back(hist);
-   AddTFileDirectory(directory, 4);
-   return containerTH2D.back()->Get();
-};
+   std::lock_guard<std::mutex> lock(mutex);
+   nIds++;
+   if (freeIndices.size() == 0) return {nIndices++, nIds};
+   const std::size_t index = freeIndices.back();
+   freeIndices.pop_back();
+   return {index, nIds};
+}
 
-std::shared_ptr<TH3D> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH3D> *hist, 
-                                                            const std::string& directory) 
+void ROOTTools::ThrObjHolder::CacheIndices::Release(const std::size_t index)
 {
-   containerTH3D.emplace_back(hist);
-   AddTFileDirectory(directory, 5);
-   return containerTH3D.back()->Get();
-};
+   std::lock_guard<std::mutex> lock(mutex);
+   freeIndices.push_back(index);
+}
 
-std::shared_ptr<TH1L> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH1L> *hist, 
-                                                            const std::string& directory) 
+ROOTTools::ThrObjHolder::CacheIndex::CacheIndex(CacheIndices& indices) : indices(&indices)
 {
-   containerTH1L.emplace_back(hist);
-   AddTFileDirectory(directory, 6);
-   return containerTH1L.back()->Get();
-};
+   std::tie(index, id) = indices.Acquire();
+}
 
-std::shared_ptr<TH2L> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH2L> *hist, 
-                                                            const std::string& directory) 
+ROOTTools::ThrObjHolder::CacheIndex::CacheIndex(const CacheIndex& other) : CacheIndex(*other.indices) {}
+
+ROOTTools::ThrObjHolder::CacheIndex& 
+ROOTTools::ThrObjHolder::CacheIndex::operator=(const CacheIndex& other)
 {
-   containerTH2L.emplace_back(hist);
-   AddTFileDirectory(directory, 7);
-   return containerTH2L.back()->Get();
-};
+   if (this == &other) return *this;
+   indices->Release(index);
+   indices = other.indices;
+   std::tie(index, id) = indices->Acquire();
+   return *this;
+}
 
-std::shared_ptr<TH3L> ROOTTools::ThrObjHolder::AddHistogram(ROOT::TThreadedObject<TH3L> *hist, 
-                                                            const std::string& directory) 
+ROOTTools::ThrObjHolder::CacheIndex::~CacheIndex()
 {
-   containerTH3L.emplace_back(hist);
-   AddTFileDirectory(directory, 8);
-   return containerTH3L.back()->Get();
-};
+   indices->Release(index);
+}
 
-void ROOTTools::ThrObjHolder::Clear()
+void ROOTTools::ThrObjHolder::Holder::FlushAll()
 {
-   containerTH1F.clear();
-   containerTH2F.clear();
-   containerTH3F.clear();
+   // every storage fills a different copy of the histogram hence they can be flushed concurrently
+   if (parallelMerge)
+   {
+      RunOnPool(containerFlushable.size(), [&](const std::size_t i)
+      {
+         containerFlushable[i]->Flush();
+      });
+   }
+   else 
+   {
+      for (std::unique_ptr<Flushable>& flushable : containerFlushable) flushable->Flush();
+   }
+}
 
-   containerTH1D.clear();
-   containerTH2D.clear();
-   containerTH3D.clear();
+void ROOTTools::ThrObjHolder::Holder::AddTFileDirectory(const std::string& name, 
+                                                        const std::string& directory, 
+                                                        ContainerBase& container,
+                                                        const std::size_t histIndex)
+{
+   // "det/sector3/" and "/det/sector3" are the same directory as "det/sector3"
+   const std::size_t first = directory.find_first_not_of('/');
+   const std::string dirName = (first == std::string::npos) ? "" : 
+      directory.substr(first, directory.find_last_not_of('/') - first + 1);
 
-   containerTH1L.clear();
-   containerTH2L.clear();
-   containerTH3L.clear();
+   std::size_t dirIndex = 0;
+   if (dirName != "")
+   {
+      auto dir = tFileDirIndex.find(dirName);
+      if (dir == tFileDirIndex.end())
+      {
+         containerTFileDir.push_back(dirName);
+         dir = tFileDirIndex.emplace(dirName, containerTFileDir.size()).first;
+      }
+      dirIndex = dir->second;
+   }
 
-   containerTFileDir.clear();
-   for (auto& vec : containerTFileDirIndex)
+   if (dirIndex >= container.dirHists.size()) 
    {
-      vec.clear();
+      container.dirHists.resize(dirIndex + 1);
+      container.dirHistNames.resize(dirIndex + 1);
    }
+   container.dirHists[dirIndex].push_back(histIndex);
+   container.dirHistNames[dirIndex].push_back(name);
+
+   if (dirIndex >= dirObjects.size()) dirObjects.resize(dirIndex + 1);
+   dirObjects[dirIndex].emplace_back(&container, histIndex);
 }
 
-void ROOTTools::ThrObjHolder::AddTFileDirectory(const std::string& directory, const int thrObjIndex)
+std::vector<TDirectory *> 
+ROOTTools::ThrObjHolder::Holder::MakeDirectories(TDirectory *outputDir, 
+                                                 const std::vector<std::string>& dirNames)
 {
-   int dirIndex = -999;
-   if (directory != "")
+   // each directory is created (together with its parents) once and histograms are 
+   // written through the pointers to directories hence gDirectory is never changed
+   std::vector<TDirectory *> dirs{outputDir};
+   for (const std::string& dirName : dirNames)
    {
-      for (long unsigned int i = 0; i < containerTFileDir.size(); i++)
+      TDirectory *dir = outputDir->mkdir(dirName.c_str(), "", true);
+      if (!dir)
       {
-         if (containerTFileDir[i] == directory) 
-         {
-            dirIndex = i;
-         }
+         std::cout << "\033[1m\033[31mError:\033[0m Directory \"" << dirName << 
+                      "\" could not be created in " << outputDir->GetPath() << std::endl;
+         exit(1);
       }
-      if (dirIndex == -999) 
+      dirs.push_back(dir);
+   }
+   return dirs;
+}
+
+void ROOTTools::ThrObjHolder::Holder::SetParallelMerge(const bool parallelMerge, 
+                                                       const unsigned int nThreads, 
+                                                       const bool treeReduction)
+{
+   this->parallelMerge = parallelMerge;
+   mergeNThreads = nThreads;
+   mergeTreeReduction = treeReduction;
+}
+
+void ROOTTools::ThrObjHolder::Holder::SetStreamingWrite(const bool streamingWrite)
+{
+   this->streamingWrite = streamingWrite;
+}
+
+void ROOTTools::ThrObjHolder::Holder::SetReuseHistograms(const bool reuseHistograms)
+{
+   this->reuseHistograms = reuseHistograms;
+}
+
+void ROOTTools::ThrObjHolder::Holder::Reset()
+{
+   WaitCheckpoint();
+
+   for (std::unique_ptr<Flushable>& flushable : containerFlushable) flushable->Reset();
+
+   std::vector<std::function<void()>> resets;
+   for (std::unique_ptr<ContainerBase>& container : containers) container->AddResets(resets);
+
+   ROOT::EnableThreadSafety();
+   // histograms are reset without reallocating their arrays of bins
+   RunOnPool(resets.size(), [&](const std::size_t i)
+   {
+      resets[i]();
+   });
+}
+
+void ROOTTools::ThrObjHolder::Holder::SetNUMAAwareMerge(const bool numaAwareMerge)
+{
+   this->numaAwareMerge = numaAwareMerge;
+}
+
+void ROOTTools::ThrObjHolder::Holder::SetArena(const bool useArena, const std::size_t blockSize, 
+                                               const bool hugePages)
+{
+   this->useArena = useArena;
+   arenaBlockSize = blockSize;
+   arenaHugePages = hugePages;
+}
+
+void ROOTTools::ThrObjHolder::Holder::SetFillStats(const bool fillStats)
+{
+   this->fillStats = fillStats;
+}
+
+void ROOTTools::ThrObjHolder::Holder::SetCheckpoints(const bool checkpoints)
+{
+   this->checkpoints = checkpoints;
+}
+
+bool ROOTTools::ThrObjHolder::Holder::IsArenaEnabled() const
+{
+   return useArena;
+}
+
+bool ROOTTools::ThrObjHolder::Holder::AreCheckpointsEnabled() const
+{
+   return checkpoints;
+}
+
+std::shared_ptr<void> ROOTTools::ThrObjHolder::Holder::AllocateInArena(const std::size_t nBytes)
+{
+   std::shared_ptr<Arena> arena;
+   {
+      std::lock_guard<std::mutex> lock(arenaMutex);
+      std::weak_ptr<Arena>& threadArena = containerArena[std::this_thread::get_id()];
+      arena = threadArena.lock();
+      // arena of the thread was freed together with the last copy carved from it
+      if (!arena) 
       {
-         dirIndex = containerTFileDir.size();
-         containerTFileDir.push_back(directory);
+         arena = std::make_shared<Arena>(arenaBlockSize, arenaHugePages);
+         threadArena = arena;
       }
    }
-   containerTFileDirIndex[thrObjIndex].push_back(dirIndex);
+   // arena is used only by the calling thread hence it is not locked; the returned pointer 
+   // shares the ownership of the arena so that it is unmapped when the last of its copies is deleted
+   return std::shared_ptr<void>(arena, arena->Allocate(nBytes));
 }
 
-void ROOTTools::ThrObjHolder::Write()
+ROOTTools::ThrObjHolder::Arena::Arena(const std::size_t blockSize, const bool hugePages) : 
+   blockSize(blockSize), hugePages(hugePages) {}
+
+ROOTTools::ThrObjHolder::Arena::~Arena()
+{
+   for (std::pair<char *, std::size_t>& block : blocks) munmap(block.first, block.second);
+}
+
+void *ROOTTools::ThrObjHolder::Arena::Allocate(const std::size_t nBytes)
+{
+   // arrays start at cache line boundaries so that arrays of different histograms never share one
+   const std::size_t alignedNBytes = (nBytes + 63)/64*64;
+   if (blocks.size() == 0 || offset + alignedNBytes > blocks.back().second) AddBlock(alignedNBytes);
+
+   void *memory = blocks.back().first + offset;
+   offset += alignedNBytes;
+   return memory;
+}
+
+void ROOTTools::ThrObjHolder::Arena::AddBlock(const std::size_t nBytes)
+{
+   // huge pages are 2 MB long on most systems; blocks are rounded up so that they are fully covered
+   const std::size_t pageSize = hugePages ? 2*1024*1024 : 4096;
+   const std::size_t size = (std::max(nBytes, blockSize) + pageSize - 1)/pageSize*pageSize;
+
+   // anonymous mapping is page-aligned and zero-initialized and its pages are 
+   // allocated only when they are touched for the first time
+   void *block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (block == MAP_FAILED)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Memory block of " << size << 
+                   " bytes could not be mapped in ROOTTools::ThrObjHolder::Arena::AddBlock()" << std::endl;
+      exit(1);
+   }
+#ifdef MADV_HUGEPAGE
+   if (hugePages) madvise(block, size, MADV_HUGEPAGE);
+#endif
+
+   blocks.emplace_back(static_cast<char *>(block), size);
+   offset = 0;
+}
+
+ROOTTools::ThrObjHolder::ThreadTrees::ThreadTrees(const std::string& name, const std::string& title) : 
+   name(name), title(title) {}
+
+TTree *ROOTTools::ThrObjHolder::ThreadTrees::AddTree()
+{
+   std::lock_guard<std::mutex> lock(slotsMutex);
+
+   // new file becomes gDirectory; the previous one is restored when context is destroyed
+   TDirectory::TContext context;
+
+   Slot slot;
+   slot.file.reset(new TMemFile((name + "_" + std::to_string(slots.size())).c_str(), "RECREATE"));
+   slot.file->cd();
+   // tree is attached to the file and is deleted when the file is closed
+   slot.tree = new TTree(name.c_str(), title.c_str());
+
+   slots.push_back(std::move(slot));
+   return slots.back().tree;
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::Holder::Container<T>::AddResets(std::vector<std::function<void()>>& resets)
 {
-   for (std::string dir : containerTFileDir)
+   for (std::unique_ptr<ROOT::TThreadedObject<T>>& hist : hists)
    {
-      gDirectory->mkdir(dir.c_str());
+      if (!hist) continue;
+      for (unsigned int i = 0; i < hist->GetNSlots(); i++)
+      {
+         T *slot = hist->GetAtSlotRaw(i);
+         if (!slot) continue;
+         resets.push_back([slot]() { ResetObject(slot); });
+      }
    }
-   for (long unsigned int i = 0; i < containerTH1F.size(); i++)
+   for (std::unique_ptr<CheckpointValues<T>>& values : checkpointValues)
    {
-      if (containerTFileDirIndex[0][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[0][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH1F>>(containerTH1F[i]->Merge())->Clone()->Write();
+      if (values) resets.push_back([values = values.get()]() { values->Reset(); });
    }
-   for (long unsigned int i = 0; i < containerTH2F.size(); i++)
+}
+
+void ROOTTools::ThrObjHolder::Detach(TH1 *hist)
+{
+   hist->SetDirectory(nullptr);
+}
+
+void ROOTTools::ThrObjHolder::Detach(TEfficiency *efficiency)
+{
+   efficiency->SetDirectory(nullptr);
+}
+
+void ROOTTools::ThrObjHolder::AddObject(TH1 *target, const TH1 *source)
+{
+   target->Add(source);
+}
+
+void ROOTTools::ThrObjHolder::AddObject(TEfficiency *target, const TEfficiency *source)
+{
+   target->Add(*source);
+}
+
+void ROOTTools::ThrObjHolder::ResetObject(TH1 *hist)
+{
+   // TH1::Reset zeroes the arrays of bins without reallocating them
+   hist->Reset();
+}
+
+void ROOTTools::ThrObjHolder::ResetObject(TEfficiency *efficiency)
+{
+   // TEfficiency has no Reset hence both of its histograms are reset
+   const_cast<TH1 *>(efficiency->GetPassedHistogram())->Reset();
+   const_cast<TH1 *>(efficiency->GetTotalHistogram())->Reset();
+}
+
+std::size_t ROOTTools::ThrObjHolder::GetObjectSize(const TEfficiency *efficiency)
+{
+   // histograms of TEfficiency created with bins are TH1D, TH2D, or TH3D
+   std::size_t size = sizeof(TEfficiency);
+   for (const TH1 *hist : {efficiency->GetPassedHistogram(), efficiency->GetTotalHistogram()})
    {
-      if (containerTFileDirIndex[1][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[1][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH2F>>(containerTH2F[i]->Merge())->Clone()->Write();
+      size += sizeof(TH1D) + (hist->GetNcells() + hist->GetSumw2N())*sizeof(Double_t);
    }
-   for (long unsigned int i = 0; i < containerTH3F.size(); i++)
+   return size;
+}
+
+std::string ROOTTools::ThrObjHolder::FormatBytes(const double nBytes)
+{
+   const std::array<std::string, 5> units = {"B", "KiB", "MiB", "GiB", "TiB"};
+   double value = nBytes;
+   std::size_t unit = 0;
+   while (value >= 1024. && unit + 1 < units.size())
    {
-      if (containerTFileDirIndex[2][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[2][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH3F>>(containerTH3F[i]->Merge())->Clone()->Write();
+      value /= 1024.;
+      unit++;
    }
-   for (long unsigned int i = 0; i < containerTH1D.size(); i++)
+
+   std::ostringstream formatted;
+   if (unit == 0) formatted << static_cast<std::size_t>(value) << " " << units[unit];
+   else formatted << std::fixed << std::setprecision(2) << value << " " << units[unit];
+   return formatted.str();
+}
+
+ROOTTools::ThrObjHolder::Holder& ROOTTools::ThrObjHolder::GetDefault()
+{
+   static Holder defaultHolder;
+   return defaultHolder;
+}
+
+void ROOTTools::ThrObjHolder::Write()
+{
+   GetDefault().Write();
+}
+
+void ROOTTools::ThrObjHolder::Write(const std::string& outputFileName)
+{
+   GetDefault().Write(outputFileName);
+}
+
+std::future<void> ROOTTools::ThrObjHolder::WriteAsync(const std::string& outputFileName)
+{
+   return GetDefault().WriteAsync(outputFileName);
+}
+
+void ROOTTools::ThrObjHolder::SetReuseHistograms(const bool reuseHistograms)
+{
+   GetDefault().SetReuseHistograms(reuseHistograms);
+}
+
+void ROOTTools::ThrObjHolder::Reset()
+{
+   GetDefault().Reset();
+}
+
+void ROOTTools::ThrObjHolder::SetNUMAAwareMerge(const bool numaAwareMerge)
+{
+   GetDefault().SetNUMAAwareMerge(numaAwareMerge);
+}
+
+void ROOTTools::ThrObjHolder::SetArena(const bool useArena, const std::size_t blockSize, 
+                                       const bool hugePages)
+{
+   GetDefault().SetArena(useArena, blockSize, hugePages);
+}
+
+void ROOTTools::ThrObjHolder::SetFillStats(const bool fillStats)
+{
+   GetDefault().SetFillStats(fillStats);
+}
+
+void ROOTTools::ThrObjHolder::SetCheckpoints(const bool checkpoints)
+{
+   GetDefault().SetCheckpoints(checkpoints);
+}
+
+std::size_t ROOTTools::ThrObjHolder::EstimateMemory(const unsigned int nThreads)
+{
+   return GetDefault().EstimateMemory(nThreads);
+}
+
+void ROOTTools::ThrObjHolder::Report(const unsigned int nThreads, const std::size_t nLargest)
+{
+   GetDefault().Report(nThreads, nLargest);
+}
+
+void ROOTTools::ThrObjHolder::SetParallelMerge(const bool parallelMerge, 
+                                               const unsigned int nThreads, 
+                                               const bool treeReduction)
+{
+   GetDefault().SetParallelMerge(parallelMerge, nThreads, treeReduction);
+}
+
+void ROOTTools::ThrObjHolder::SetStreamingWrite(const bool streamingWrite)
+{
+   GetDefault().SetStreamingWrite(streamingWrite);
+}
+
+void ROOTTools::ThrObjHolder::ParallelFor(const std::size_t n, unsigned int nThreads, 
+                                          const std::function<void(const std::size_t)>& func)
+{
+   if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+   if (nThreads > n) nThreads = n;
+
+   if (nThreads <= 1)
    {
-      if (containerTFileDirIndex[3][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[3][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH1D>>(containerTH1D[i]->Merge())->Clone()->Write();
+      for (std::size_t i = 0; i < n; i++) func(i);
+      return;
    }
-   for (long unsigned int i = 0; i < containerTH2D.size(); i++)
+
+   // indices are handed out one by one so that threads that got cheap histograms 
+   // pick up the remaining ones instead of idling
+   std::atomic<std::size_t> nextIndex(0);
+   std::vector<std::thread> pool;
+   for (unsigned int i = 0; i < nThreads; i++)
    {
-      if (containerTFileDirIndex[4][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[4][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH2D>>(containerTH2D[i]->Merge())->Clone()->Write();
+      pool.emplace_back([&]()
+      {
+         for (std::size_t j = nextIndex++; j < n; j = nextIndex++) func(j);
+      });
    }
-   for (long unsigned int i = 0; i < containerTH3D.size(); i++)
+   for (std::thread& thr : pool) thr.join();
+}
+
+ROOTTools::ThrObjHolder::ThreadPool::ThreadPool(unsigned int nThreads)
+{
+   if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+   for (unsigned int i = 1; i < nThreads; i++) threads.emplace_back([this]() { Work(); });
+}
+
+ROOTTools::ThrObjHolder::ThreadPool::~ThreadPool()
+{
    {
-      if (containerTFileDirIndex[5][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[5][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH3D>>(containerTH3D[i]->Merge())->Clone()->Write();
+      std::lock_guard<std::mutex> lock(mutex);
+      isStopped = true;
    }
-   for (long unsigned int i = 0; i < containerTH1L.size(); i++)
+   runStarted.notify_all();
+   for (std::thread& thr : threads) thr.join();
+}
+
+void ROOTTools::ThrObjHolder::ThreadPool::Run(const std::size_t n, 
+                                              const std::function<void(const std::size_t)>& func)
+{
+   if (threads.size() == 0 || n <= 1)
    {
-      if (containerTFileDirIndex[6][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[6][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH1L>>(containerTH1L[i]->Merge())->Clone()->Write();
+      for (std::size_t i = 0; i < n; i++) func(i);
+      return;
    }
-   for (long unsigned int i = 0; i < containerTH2L.size(); i++)
+
    {
-      if (containerTFileDirIndex[7][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[7][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH2L>>(containerTH2L[i]->Merge())->Clone()->Write();
+      std::lock_guard<std::mutex> lock(mutex);
+      this->func = &func;
+      this->n = n;
+      nextIndex = 0;
+      nBusy = threads.size();
+      nRuns++;
    }
-   for (long unsigned int i = 0; i < containerTH3L.size(); i++)
+   runStarted.notify_all();
+
+   RunIndices();
+
+   // every thread has to report even if all indices were taken before it woke up 
+   // since the function and the indices of the next call must not be changed under it
+   std::unique_lock<std::mutex> lock(mutex);
+   runFinished.wait(lock, [&]() { return nBusy == 0; });
+   this->func = nullptr;
+}
+
+void ROOTTools::ThrObjHolder::ThreadPool::Work()
+{
+   std::uint64_t nDoneRuns = 0;
+   while (true)
    {
-      if (containerTFileDirIndex[8][i] != -999) gDirectory->cd(
-         containerTFileDir[containerTFileDirIndex[8][i]].c_str());
-      else gDirectory->cd();
-      static_cast<std::shared_ptr<TH3L>>(containerTH3L[i]->Merge())->Clone()->Write();
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         runStarted.wait(lock, [&]() { return isStopped || nRuns != nDoneRuns; });
+         if (isStopped) return;
+         nDoneRuns = nRuns;
+      }
+
+      RunIndices();
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         nBusy--;
+      }
+      runFinished.notify_one();
    }
-   Clear();
 }
 
-void ROOTTools::ThrObjHolder::Write(const std::string& outputFileName)
+void ROOTTools::ThrObjHolder::ThreadPool::RunIndices()
 {
-   TFile outputFile(outputFileName.c_str(), "RECREATE");
-   outputFile.cd();
-   Write();
-   outputFile.Close();
+   // indices are handed out one by one so that threads that got cheap histograms 
+   // pick up the remaining ones instead of idling
+   for (std::size_t i = nextIndex++; i < n; i = nextIndex++) (*func)(i);
 }
- 
-template<typename T>
-ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
-                             const int xNBins, const double xLow, const double xUp,
-                             const std::string& fileDirectory)
+
+void ROOTTools::ThrObjHolder::Holder::RunOnPool(const std::size_t n, 
+                                                const std::function<void(const std::size_t)>& func)
 {
-   objPtr = ThrObjHolder::AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
-                                                                    xNBins, xLow, xUp), 
-                                       fileDirectory);
+   if (writePool) writePool->Run(n, func);
+   else ParallelFor(n, mergeNThreads, func);
 }
 
-template<typename T>
-ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
-                             const int xNBins, const double xLow, const double xUp, 
-                             const int yNBins, const double yLow, const double yUp,
-                             const std::string& fileDirectory)
+int ROOTTools::ThrObjHolder::GetNUMANode(const void *address)
 {
-   objPtr = ThrObjHolder::AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
-                                                                    xNBins, xLow, xUp, 
-                                                                    yNBins, yLow, yUp),
-                                       fileDirectory);
+#if defined(__linux__) && defined(SYS_move_pages)
+   const std::uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+   void *page = reinterpret_cast<void *>(reinterpret_cast<std::uintptr_t>(address)/pageSize*pageSize);
+   // move_pages without target nodes does not move anything and only reports the node of each page
+   int status = -1;
+   if (syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) == 0 && status >= 0) return status;
+#else
+   (void) address;
+#endif
+   return -1;
 }
 
-template<typename T>
-ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
-                             const int xNBins, const double xLow, const double xUp, 
-                             const int yNBins, const double yLow, const double yUp,
-                             const int zNBins, const double zLow, const double zUp,
-                             const std::string& fileDirectory)
+std::vector<int> ROOTTools::ThrObjHolder::GetNUMANodeCPUs(const int node)
+{
+   std::vector<int> cpus;
+   if (node < 0) return cpus;
+
+   // list has the format of "0-15,32-47"
+   std::ifstream cpuListFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+   std::string cpuList;
+   if (!(cpuListFile >> cpuList)) return cpus;
+
+   // returns -1 if the text is not a number of CPU
+   const auto parseCPU = [](const std::string& text) -> long
+   {
+      if (text.size() == 0 || text.find_first_not_of("0123456789") != std::string::npos || 
+          text.size() > 9) return -1;
+      return std::strtol(text.c_str(), nullptr, 10);
+   };
+
+   std::stringstream cpuListStream(cpuList);
+   std::string cpuRange;
+   while (std::getline(cpuListStream, cpuRange, ','))
+   {
+      const std::size_t dash = cpuRange.find('-');
+      const long firstCPU = parseCPU(cpuRange.substr(0, dash));
+      const long lastCPU = (dash == std::string::npos) ? firstCPU : parseCPU(cpuRange.substr(dash + 1));
+      // list in unexpected format is treated as unknown
+      if (firstCPU < 0 || lastCPU < firstCPU) return {};
+      for (long cpu = firstCPU; cpu <= lastCPU; cpu++) cpus.push_back(static_cast<int>(cpu));
+   }
+   return cpus;
+}
+
+std::vector<int> ROOTTools::ThrObjHolder::GetCPUAffinity()
+{
+   std::vector<int> cpus;
+#ifdef __linux__
+   cpu_set_t cpuSet;
+   if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0) return cpus;
+   for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+   {
+      if (CPU_ISSET(cpu, &cpuSet)) cpus.push_back(cpu);
+   }
+#endif
+   return cpus;
+}
+
+bool ROOTTools::ThrObjHolder::SetCPUAffinity(const std::vector<int>& cpus)
 {
-   objPtr = ThrObjHolder::AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
-                                                                    xNBins, xLow, xUp, 
-                                                                    yNBins, yLow, yUp,
-                                                                    zNBins, zLow, zUp),
-                                       fileDirectory);
+   if (cpus.size() == 0) return false;
+#ifdef __linux__
+   cpu_set_t cpuSet;
+   CPU_ZERO(&cpuSet);
+   for (const int cpu : cpus) 
+   {
+      if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+      CPU_SET(cpu, &cpuSet);
+   }
+   return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) == 0;
+#else
+   return false;
+#endif
 }
 
 template<typename T>
-std::shared_ptr<T> ROOTTools::ThrObj<T>::Get()
+std::shared_ptr<T> ROOTTools::ThrObjHolder::Holder::MergeSlots(ROOT::TThreadedObject<T> *hist, 
+                                                               CheckpointValues<T> *values,
+                                                               const unsigned int nThreads, 
+                                                               const bool treeReduction)
 {
-   return objPtr;
-}
-
-// explicit instantiations of ROOTTools::ThrObj for different types of histograms
-template ROOTTools::ThrObj<TH1F>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH2F>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH3F>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH1D>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH2D>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH3D>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH1L>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH2L>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const std::string&);
-template ROOTTools::ThrObj<TH3L>::ThrObj(const std::string&, const std::string&, 
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const int, const double, const double,
-                                         const std::string&);
-
-// explicit instantiations of ROOTTools::ThrObj::Get() for different types of histograms
-template std::shared_ptr<TH1F> ROOTTools::ThrObj<TH1F>::Get();
-template std::shared_ptr<TH2F> ROOTTools::ThrObj<TH2F>::Get();
-template std::shared_ptr<TH3F> ROOTTools::ThrObj<TH3F>::Get();
-template std::shared_ptr<TH1D> ROOTTools::ThrObj<TH1D>::Get();
-template std::shared_ptr<TH2D> ROOTTools::ThrObj<TH2D>::Get();
-template std::shared_ptr<TH3D> ROOTTools::ThrObj<TH3D>::Get();
-template std::shared_ptr<TH1L> ROOTTools::ThrObj<TH1L>::Get();
-template std::shared_ptr<TH2L> ROOTTools::ThrObj<TH2L>::Get();
-template std::shared_ptr<TH3L> ROOTTools::ThrObj<TH3L>::Get();
+   // parallel steps run on the pool of Write; the histogram that is itself merged 
+   // on one of the threads of the pool is merged serially since the pool can not be nested
+   const auto forEach = [&](const std::size_t n, const std::function<void(const std::size_t)>& func)
+   {
+      if (nThreads > 1) RunOnPool(n, func);
+      else for (std::size_t i = 0; i < n; i++) func(i);
+   };
+
+   // copies are allocated only on the first fill on each thread, 
+   // hence only the slots of the threads that filled the histogram are merged
+   std::vector<std::shared_ptr<T>> slots;
+   for (unsigned int i = 0; i < hist->GetNSlots(); i++)
+   {
+      std::shared_ptr<T> slot = hist->GetAtSlotUnchecked(i);
+      if (slot) slots.push_back(slot);
+   }
+   // spare copies and the sum of checkpoints are merged after the copies so that the first copy stays the target
+   if (values)
+   {
+      for (typename CheckpointValues<T>::Participant& participant : values->participants)
+      {
+         if (participant.spareHist) slots.push_back(participant.spareHist);
+      }
+      if (values->sum) slots.push_back(values->sum);
+   }
+
+   // histogram that was never filled is written as the clone of its model; 
+   // no slot is allocated for it so that reuse mode does not keep an extra copy
+   if (slots.size() == 0) return hist->SnapshotMerge();
+   if (slots.size() == 1) return slots.front();
+
+   if (numaAwareMerge)
+   {
+      // copies are grouped by the nodes of their bins in the order of the first copy of each node
+      std::vector<int> nodes;
+      std::vector<std::vector<std::shared_ptr<T>>> nodeSlots;
+      for (std::shared_ptr<T>& slot : slots)
+      {
+         // bins of TEfficiency are in its histograms which are allocated together with it
+         const void *address;
+         if constexpr (std::is_base_of<TH1, T>::value) address = slot->GetArray();
+         else address = slot.get();
+         const int node = GetNUMANode(address);
+         const std::size_t nodeIndex = std::find(nodes.begin(), nodes.end(), node) - nodes.begin();
+         if (nodeIndex == nodes.size())
+         {
+            nodes.push_back(node);
+            nodeSlots.emplace_back();
+         }
+         nodeSlots[nodeIndex].push_back(slot);
+      }
+
+      // copies are merged as usual if the node or the CPUs of any of them are unknown
+      std::vector<std::vector<int>> nodeCPUs;
+      for (const int node : nodes) nodeCPUs.push_back(GetNUMANodeCPUs(node));
+      const bool isKnown = std::none_of(nodeCPUs.begin(), nodeCPUs.end(), 
+                                        [](const std::vector<int>& cpus) { return cpus.size() == 0; });
+
+      if (nodes.size() > 1 && isKnown)
+      {
+         // copies of each node are merged by the thread that runs on this node
+         forEach(nodes.size(), [&](const std::size_t i)
+         {
+            if (nodeSlots[i].size() == 1) return;
+
+            // thread is bound to the node only if its affinity can be restored afterwards
+            const std::vector<int> previousCPUs = GetCPUAffinity();
+            const bool isBound = previousCPUs.size() > 0 && SetCPUAffinity(nodeCPUs[i]);
+
+            TList list;
+            for (std::size_t j = 1; j < nodeSlots[i].size(); j++) list.Add(nodeSlots[i][j].get());
+            nodeSlots[i].front()->Merge(&list);
+
+            if (isBound) SetCPUAffinity(previousCPUs);
+         });
+
+         // cross-node reduction reads only one copy per node
+         TList list;
+         for (std::size_t i = 1; i < nodes.size(); i++) list.Add(nodeSlots[i].front().get());
+         nodeSlots.front().front()->Merge(&list);
+         return nodeSlots.front().front();
+      }
+   }
+
+   if (!treeReduction)
+   {
+      // same order as in TThreadedObject::Merge
+      TList list;
+      for (std::size_t i = 1; i < slots.size(); i++) list.Add(slots[i].get());
+      slots.front()->Merge(&list);
+      return slots.front();
+   }
+
+   // on each level copy i + stride is merged into copy i for every i that is a multiple of 2*stride
+   for (std::size_t stride = 1; stride < slots.size(); stride *= 2)
+   {
+      const std::size_t nPairs = (slots.size() + stride - 1)/(2*stride);
+      forEach(nPairs, [&](const std::size_t pair)
+      {
+         TList list;
+         list.Add(slots[2*stride*pair + stride].get());
+         slots[2*stride*pair]->Merge(&list);
+      });
+   }
+   return slots.front();
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::Holder::Container<T>::Merge(Holder& holder)
+{
+   mergedHists.assign(hists.size(), nullptr);
+
+   // in serial and streaming modes histograms are merged one by one right before being written
+   if (!holder.parallelMerge || holder.streamingWrite || hists.size() == 0) return;
+
+   unsigned int nThreads = holder.mergeNThreads;
+   if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+
+   if (holder.mergeTreeReduction && hists.size() < nThreads)
+   {
+      // few histograms can not keep the pool busy hence the copies of each of them 
+      // are reduced on the whole pool one histogram after another
+      for (std::size_t i = 0; i < hists.size(); i++)
+      {
+         mergedHists[i] = holder.MergeSlots(hists[i].get(), checkpointValues[i].get(), nThreads, true);
+      }
+      return;
+   }
+
+   holder.RunOnPool(hists.size(), [&](const std::size_t i)
+   {
+      mergedHists[i] = holder.MergeSlots(hists[i].get(), checkpointValues[i].get(), 1, 
+                                         holder.mergeTreeReduction);
+   });
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::Holder::Container<T>::Write(Holder& holder, const std::size_t histIndex, 
+                                                         TDirectory *dir)
+{
+   // writing is always done on the calling thread
+   if (!mergedHists[histIndex]) 
+   {
+      unsigned int nThreads = holder.mergeNThreads;
+      if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+      // the pool of Write exists only in parallel mode
+      mergedHists[histIndex] = holder.MergeSlots(hists[histIndex].get(), 
+                                                 checkpointValues[histIndex].get(), 
+                                                 holder.parallelMerge ? nThreads : 1, 
+                                                 holder.parallelMerge && holder.mergeTreeReduction);
+   }
+
+   dir->WriteTObject(mergedHists[histIndex].get());
+
+   if (holder.streamingWrite && !holder.reuseHistograms)
+   {
+      // merged histogram is one of the per-thread copies so it is freed together with them
+      mergedHists[histIndex].reset();
+      hists[histIndex].reset();
+      checkpointValues[histIndex].reset();
+   }
+}
+
+void ROOTTools::ThrObjHolder::Holder::TreeContainer::Merge(Holder& holder)
+{
+   std::vector<ThreadTrees::Slot *> slots;
+   for (std::unique_ptr<ThreadTrees>& threadTrees : trees)
+   {
+      for (ThreadTrees::Slot& slot : threadTrees->slots) slots.push_back(&slot);
+   }
+
+   // compression of the baskets that are still in memory is the only part of the merge 
+   // that is not copying; every tree is flushed into its own file hence they can be flushed concurrently
+   if (holder.parallelMerge)
+   {
+      holder.RunOnPool(slots.size(), [&](const std::size_t i)
+      {
+         slots[i]->tree->FlushBaskets();
+      });
+   }
+   else 
+   {
+      for (ThreadTrees::Slot *slot : slots) slot->tree->FlushBaskets();
+   }
+}
+
+void ROOTTools::ThrObjHolder::Holder::TreeContainer::Write(Holder& holder, const std::size_t histIndex, 
+                                                          TDirectory *dir)
+{
+   // merged tree is created in dir; gDirectory is restored when context is destroyed
+   TDirectory::TContext context(dir);
+
+   std::unique_ptr<TTree> mergedTree;
+   // tree that was never filled is written empty
+   if (trees[histIndex]->slots.size() == 0) 
+   {
+      mergedTree.reset(new TTree(trees[histIndex]->name.c_str(), trees[histIndex]->title.c_str()));
+   }
+   else
+   {
+      TList list;
+      for (ThreadTrees::Slot& slot : trees[histIndex]->slots) list.Add(slot.tree);
+      // compressed baskets are copied into the output file as they are
+      mergedTree.reset(TTree::MergeTrees(&list, "fast"));
+   }
+   mergedTree->Write("", TObject::kOverwrite);
+
+   if (holder.streamingWrite && !holder.reuseHistograms) trees[histIndex].reset();
+}
+
+void ROOTTools::ThrObjHolder::Holder::TreeContainer::AddResets(std::vector<std::function<void()>>& resets)
+{
+   for (std::unique_ptr<ThreadTrees>& threadTrees : trees)
+   {
+      if (!threadTrees) continue;
+      for (ThreadTrees::Slot& slot : threadTrees->slots)
+      {
+         TMemFile *file = slot.file.get();
+         // baskets are removed from the file and entries are removed from the tree
+         resets.push_back([file]() { file->ResetAfterMerge(nullptr); });
+      }
+   }
+}
+
+void ROOTTools::ThrObjHolder::Holder::TreeContainer::AddSnapshots(std::vector<Snapshot>&, const std::uint64_t,
+                                                                 const std::chrono::steady_clock::time_point) {}
+
+void ROOTTools::ThrObjHolder::Holder::TreeContainer::Resume(Holder&, TFile&) {}
+
+void ROOTTools::ThrObjHolder::Holder::PrintFillStats(const std::size_t nRows)
+{
+   struct FillStats
+   {
+      const FillCounters *counters;
+      std::uint64_t nFills;
+      std::uint64_t maxThreadFills;
+      std::size_t nThreads;
+      double seconds;
+   };
+
+   std::vector<FillStats> stats;
+   std::vector<const FillCounters *> unfilled;
+   double totalSeconds = 0.;
+   {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      for (std::unique_ptr<FillCounters>& fillCounters : containerFillCounters)
+      {
+         std::lock_guard<std::mutex> countersLock(fillCounters->countersMutex);
+
+         FillStats entry{fillCounters.get(), 0, 0, 0, 0.};
+         for (FillCounter& counter : fillCounters->counters)
+         {
+            if (counter.nFills == 0) continue;
+            entry.nFills += counter.nFills;
+            entry.maxThreadFills = std::max(entry.maxThreadFills, counter.nFills);
+            entry.nThreads++;
+            // time of the fills that were not timed is extrapolated from the ones that were
+            if (counter.nTimedFills != 0)
+            {
+               entry.seconds += counter.timedSeconds/static_cast<double>(counter.nTimedFills)*
+                                static_cast<double>(counter.nFills);
+            }
+            counter = FillCounter();
+         }
+
+         if (entry.nFills == 0) unfilled.push_back(fillCounters.get());
+         else
+         {
+            totalSeconds += entry.seconds;
+            stats.push_back(entry);
+         }
+      }
+   }
+
+   std::sort(stats.begin(), stats.end(), [](const FillStats& a, const FillStats& b)
+   {
+      return a.seconds > b.seconds;
+   });
+
+   auto GetPath = [](const FillCounters *counters)
+   {
+      return (counters->directory == "") ? counters->name : 
+             counters->directory + "/" + counters->name;
+   };
+
+   const std::ios_base::fmtflags flags = std::cout.flags();
+   const std::streamsize precision = std::cout.precision();
+
+   std::cout << "Fill statistics of " << stats.size() << " filled histograms" << 
+                " (estimated total fill time " << std::fixed << std::setprecision(3) << 
+                totalSeconds << " s):" << std::endl;
+   std::cout << std::setw(14) << "fills" << std::setw(14) << "max/thread" << 
+                std::setw(9) << "threads" << std::setw(12) << "time [s]" << 
+                std::setw(9) << "share" << "  name" << std::endl;
+   for (std::size_t i = 0; i < stats.size() && i < nRows; i++)
+   {
+      const double share = (totalSeconds > 0.) ? 100.*stats[i].seconds/totalSeconds : 0.;
+      std::cout << std::setw(14) << stats[i].nFills << std::setw(14) << stats[i].maxThreadFills << 
+                   std::setw(9) << stats[i].nThreads << std::setw(12) << std::setprecision(4) << 
+                   stats[i].seconds << std::setw(8) << std::setprecision(1) << share << "%  " << 
+                   GetPath(stats[i].counters) << std::endl;
+   }
+
+   if (unfilled.size() != 0)
+   {
+      std::cout << "\033[1m\033[35mWarning:\033[0m " << unfilled.size() << 
+                   " histograms were never filled:" << std::endl;
+      for (std::size_t i = 0; i < unfilled.size() && i < nRows; i++)
+      {
+         std::cout << "   " << GetPath(unfilled[i]) << std::endl;
+      }
+      if (unfilled.size() > nRows) 
+      {
+         std::cout << "   ... and " << unfilled.size() - nRows << " more" << std::endl;
+      }
+   }
+
+   std::cout.flags(flags);
+   std::cout.precision(precision);
+}
+
+void ROOTTools::ThrObjHolder::Holder::Write()
+{
+   WaitCheckpoint();
+
+   if (parallelMerge) 
+   {
+      ROOT::EnableThreadSafety();
+      // threads are started once and all parallel steps of the write run on them
+      writePool = std::make_unique<ThreadPool>(mergeNThreads);
+   }
+
+   // stats are empty unless they were enabled with SetFillStats
+   if (containerFillCounters.size() != 0) PrintFillStats();
+
+   FlushAll();
+
+   std::vector<TDirectory *> dirs = MakeDirectories(gDirectory, containerTFileDir);
+
+   for (std::unique_ptr<ContainerBase>& container : containers) container->Merge(*this);
+
+   // objects of different types are written in the order of registration within each directory
+   for (std::size_t i = 0; i < dirObjects.size(); i++)
+   {
+      for (const std::pair<ContainerBase *, std::size_t>& object : dirObjects[i]) 
+      {
+         object.first->Write(*this, object.second, dirs[i]);
+      }
+   }
+
+   // merged histograms are the first copies of each histogram hence they are reset as well
+   if (reuseHistograms) Reset();
+   else Clear();
+
+   writePool.reset();
+}
+
+void ROOTTools::ThrObjHolder::Holder::Write(const std::string& outputFileName)
+{
+   TFile outputFile(outputFileName.c_str(), "RECREATE");
+   outputFile.cd();
+   Write();
+   outputFile.Close();
+}
+ 
+std::future<void> ROOTTools::ThrObjHolder::Holder::WriteAsync(const std::string& outputFileName)
+{
+   // checkpoint thread reads the containers that are about to be handed over
+   WaitCheckpoint();
+
+   std::unique_ptr<Holder> writeHolder = std::make_unique<Holder>();
+   HandOver(*writeHolder);
+
+   ROOT::EnableThreadSafety();
+   return std::async(std::launch::async, 
+                     [writeHolder = std::move(writeHolder), outputFileName]()
+   {
+      writeHolder->Write(outputFileName);
+   });
+}
+
+void ROOTTools::ThrObjHolder::Holder::HandOver(Holder& holder)
+{
+   std::lock_guard<std::mutex> registryLock(registryMutex);
+   std::lock_guard<std::mutex> flushableLock(flushableMutex);
+
+   // swap leaves this holder with the empty containers of the new holder
+   holder.containers.swap(containers);
+   holder.containerIndex.swap(containerIndex);
+
+   holder.containerTFileDir.swap(containerTFileDir);
+   holder.tFileDirIndex.swap(tFileDirIndex);
+   holder.dirObjects.swap(dirObjects);
+   std::swap(holder.nSlots, nSlots);
+
+   holder.containerFlushable.swap(containerFlushable);
+   holder.containerFillCounters.swap(containerFillCounters);
+   holder.containerArena.swap(containerArena);
+
+   holder.parallelMerge = parallelMerge;
+   holder.mergeNThreads = mergeNThreads;
+   holder.mergeTreeReduction = mergeTreeReduction;
+   holder.streamingWrite = streamingWrite;
+   holder.reuseHistograms = reuseHistograms;
+   holder.numaAwareMerge = numaAwareMerge;
+   holder.useArena = useArena;
+   holder.arenaBlockSize = arenaBlockSize;
+   holder.arenaHugePages = arenaHugePages;
+   holder.fillStats = fillStats;
+   holder.checkpoints = checkpoints;
+}
+
+ROOTTools::ThrObjHolder::Holder::~Holder()
+{
+   WaitCheckpoint();
+}
+
+bool ROOTTools::ThrObjHolder::Holder::Checkpoint(const std::string& checkpointFileName, 
+                                                 const double gracePeriod)
+{
+   if (!checkpoints)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Checkpoints are not enabled in " << 
+                   "ROOTTools::ThrObjHolder::Holder::Checkpoint(); see " << 
+                   "ROOTTools::ThrObjHolder::Holder::SetCheckpoints" << std::endl;
+      exit(1);
+   }
+
+   std::lock_guard<std::mutex> lock(checkpointMutex);
+   if (isCheckpointRunning.exchange(true)) return false;
+
+   // the previous checkpoint thread has already finished but it still needs to be joined
+   if (checkpointThread.joinable()) checkpointThread.join();
+
+   // threads hand over their values on their first fill in the new epoch
+   const std::uint64_t epoch = ++checkpointEpoch;
+   const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + 
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+         std::chrono::duration<double>(gracePeriod));
+
+   ROOT::EnableThreadSafety();
+   checkpointThread = std::thread(&Holder::WriteCheckpoint, this, checkpointFileName, epoch, deadline);
+   return true;
+}
+
+void ROOTTools::ThrObjHolder::Holder::WaitCheckpoint()
+{
+   std::lock_guard<std::mutex> lock(checkpointMutex);
+   if (checkpointThread.joinable()) checkpointThread.join();
+}
+
+std::uint64_t ROOTTools::ThrObjHolder::Holder::GetCheckpointEpoch() const
+{
+   return checkpointEpoch.load(std::memory_order_relaxed);
+}
+
+unsigned int ROOTTools::ThrObjHolder::Holder::GetNSlots()
+{
+   std::lock_guard<std::mutex> lock(registryMutex);
+   return nSlots;
+}
+
+void ROOTTools::ThrObjHolder::Holder::WriteCheckpoint(const std::string& checkpointFileName, 
+                                                      const std::uint64_t epoch,
+                                                      const std::chrono::steady_clock::time_point deadline)
+{
+   // only the list of objects is taken under the lock; histograms can be added while 
+   // the values of threads are waited for and the file is written
+   std::vector<std::string> dirNames;
+   std::vector<Snapshot> snapshots;
+   {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      dirNames = containerTFileDir;
+      for (std::unique_ptr<ContainerBase>& container : containers) 
+      {
+         container->AddSnapshots(snapshots, epoch, deadline);
+      }
+   }
+
+   const std::string tmpFileName = checkpointFileName + ".tmp";
+   TFile checkpointFile(tmpFileName.c_str(), "RECREATE");
+   std::vector<TDirectory *> dirs = MakeDirectories(&checkpointFile, dirNames);
+
+   std::size_t nStale = 0;
+   for (Snapshot& snapshot : snapshots)
+   {
+      std::shared_ptr<TObject> object = snapshot.get(nStale);
+      // histogram that was not filled yet is not written
+      if (object) dirs[snapshot.dirIndex]->WriteTObject(object.get());
+   }
+   if (nStale > 0)
+   {
+      std::cout << "\033[1m\033[35mWarning:\033[0m " << nStale << " per-thread copies of histograms " << 
+                   "were not filled during the grace period of checkpoint " << checkpointFileName << 
+                   "; their values since the previous checkpoint will be included in the later ones" << std::endl;
+   }
+
+   checkpointFile.Close();
+
+   // rename is atomic hence the checkpoint file is always either the previous or the new complete one
+   if (std::rename(tmpFileName.c_str(), checkpointFileName.c_str()) != 0)
+   {
+      std::cout << "\033[1m\033[35mWarning:\033[0m Checkpoint file " << tmpFileName << 
+                   " could not be renamed to " << checkpointFileName << std::endl;
+   }
+
+   isCheckpointRunning = false;
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::Holder::Container<T>::AddSnapshots(std::vector<Snapshot>& snapshots, 
+                                                                const std::uint64_t epoch,
+                                                                const std::chrono::steady_clock::time_point deadline)
+{
+   for (std::size_t dirIndex = 0; dirIndex < dirHists.size(); dirIndex++)
+   {
+      for (const std::size_t i : dirHists[dirIndex])
+      {
+         // objects of ThrCounter and ThrCutflow are filled from their storages only in Write
+         CheckpointValues<T> *values = checkpointValues[i].get();
+         if (!values) continue;
+         snapshots.push_back({dirIndex, [values, epoch, deadline](std::size_t& nStale) -> std::shared_ptr<TObject>
+         {
+            return values->GetSnapshot(epoch, deadline, nStale);
+         }});
+      }
+   }
+}
+
+template<typename T>
+ROOTTools::ThrObjHolder::CheckpointValues<T>::CheckpointValues(const std::function<T *()>& createEmpty) : 
+   createEmpty(createEmpty) {}
+
+template<typename T>
+typename ROOTTools::ThrObjHolder::CheckpointValues<T>::Participant& 
+ROOTTools::ThrObjHolder::CheckpointValues<T>::AddParticipant(const std::uint64_t epoch)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   Participant& participant = participants.emplace_back();
+   participant.epoch.store(epoch, std::memory_order_relaxed);
+   return participant;
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::CheckpointValues<T>::AddValues(Participant& participant, 
+                                                             const std::function<void(T *, const unsigned int)>& moveValues,
+                                                             const std::shared_ptr<T>& spareHist)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   participant.moveValues.push_back(moveValues);
+   if (spareHist) participant.spareHist = spareHist;
+}
+
+template<typename T>
+std::shared_ptr<T> 
+ROOTTools::ThrObjHolder::CheckpointValues<T>::GetSnapshot(const std::uint64_t epoch,
+                                                          const std::chrono::steady_clock::time_point deadline,
+                                                          std::size_t& nStale)
+{
+   // threads switch on their next fill and are never blocked by this thread, hence they are polled
+   const auto isSwitched = [&]()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return std::all_of(participants.begin(), participants.end(), [&](const Participant& participant) 
+      { 
+         return participant.epoch.load(std::memory_order_acquire) == epoch; 
+      });
+   };
+   while (!isSwitched() && std::chrono::steady_clock::now() < deadline)
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+
+   std::function<void(T *)> addSharedValues;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (Participant& participant : participants)
+      {
+         // side that the thread left is not filled until the next checkpoint which starts 
+         // only after this one is finished; threads that did not switch yet keep filling 
+         // their current side, hence their values stay there until the checkpoint in which they switch
+         if (participant.epoch.load(std::memory_order_acquire) != epoch)
+         {
+            nStale++;
+            continue;
+         }
+         for (const std::function<void(T *, const unsigned int)>& moveValues : participant.moveValues)
+         {
+            if (!sum)
+            {
+               sum.reset(createEmpty());
+               Detach(sum.get());
+            }
+            moveValues(sum.get(), 1 - participant.side);
+         }
+      }
+      addSharedValues = addShared;
+   }
+
+   // sum is changed only by this thread until the checkpoint is finished hence it is cloned outside of the lock
+   if (!sum) return nullptr;
+   std::shared_ptr<T> snapshot(static_cast<T *>(sum->Clone()));
+   Detach(snapshot.get());
+   // shared bins are filled by the same threads whose statistics were moved above
+   if (addSharedValues) addSharedValues(snapshot.get());
+   return snapshot;
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::CheckpointValues<T>::Reset()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   for (Participant& participant : participants)
+   {
+      if (participant.spareHist) ResetObject(participant.spareHist.get());
+   }
+   sum.reset();
+}
+
+void ROOTTools::ThrObjHolder::Holder::Resume(const std::string& checkpointFileName)
+{
+   TFile checkpointFile(checkpointFileName.c_str(), "READ");
+   if (checkpointFile.IsZombie())
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Checkpoint file " << checkpointFileName << 
+                   " could not be opened in ROOTTools::ThrObjHolder::Holder::Resume()" << std::endl;
+      exit(1);
+   }
+
+   for (std::unique_ptr<ContainerBase>& container : containers) 
+   {
+      container->Resume(*this, checkpointFile);
+   }
+
+   checkpointFile.Close();
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::Holder::Container<T>::Resume(Holder& holder, TFile& checkpointFile)
+{
+   for (std::size_t dirIndex = 0; dirIndex < dirHists.size(); dirIndex++)
+   {
+      const std::string dirPrefix = (dirIndex == 0) ? "" : 
+         holder.containerTFileDir[dirIndex - 1] + "/";
+      for (std::size_t j = 0; j < dirHists[dirIndex].size(); j++)
+      {
+         std::unique_ptr<T> savedHist(checkpointFile.Get<T>((dirPrefix + 
+                                                              dirHistNames[dirIndex][j]).c_str()));
+         if (!savedHist) continue;
+         Detach(savedHist.get());
+
+         const std::size_t i = dirHists[dirIndex][j];
+         CheckpointValues<T> *values = checkpointValues[i].get();
+         if (!values) 
+         {
+            AddObject(hists[i]->Get().get(), savedHist.get());
+            continue;
+         }
+         // values are kept apart from the copies so that they are included in the next checkpoints 
+         // even if the calling thread does not fill the histogram
+         std::lock_guard<std::mutex> lock(values->mutex);
+         if (values->sum) AddObject(values->sum.get(), savedHist.get());
+         else values->sum = std::move(savedHist);
+      }
+   }
+}
+
+template<typename T>
+void ROOTTools::ThrObjHolder::Holder::Container<T>::AddMemoryEntries(std::vector<MemoryEntry>& entries, 
+                                                                    const bool sizeModels)
+{
+   for (std::size_t dirIndex = 0; dirIndex < dirHists.size(); dirIndex++)
+   {
+      for (std::size_t j = 0; j < dirHists[dirIndex].size(); j++)
+      {
+         ROOT::TThreadedObject<T> *hist = hists[dirHists[dirIndex][j]].get();
+         if (!hist) continue;
+
+         std::size_t nCopies = 0;
+         const T *copy = nullptr;
+         for (unsigned int slot = 0; slot < hist->GetNSlots(); slot++)
+         {
+            const T *slotHist = hist->GetAtSlotRaw(slot);
+            if (!slotHist) continue;
+            if (!copy) copy = slotHist;
+            nCopies++;
+         }
+
+         MemoryEntry entry;
+         entry.type = T::Class_Name();
+         entry.dirIndex = dirIndex;
+         entry.name = dirHistNames[dirIndex][j];
+         if (copy) entry.bytesPerCopy = GetObjectSize(copy);
+         // objects without copies are sized by their numbers of bins without allocating them
+         else entry.bytesPerCopy = sizeModels ? GetModelSize<T>(nCells[dirHists[dirIndex][j]]) : 0;
+         entry.nCopies = nCopies;
+         entry.isPerThread = true;
+         entries.push_back(entry);
+      }
+   }
+}
+
+void ROOTTools::ThrObjHolder::Holder::TreeContainer::AddMemoryEntries(std::vector<MemoryEntry>& entries,
+                                                                     const bool)
+{
+   for (std::size_t dirIndex = 0; dirIndex < dirHists.size(); dirIndex++)
+   {
+      for (std::size_t j = 0; j < dirHists[dirIndex].size(); j++)
+      {
+         ThreadTrees *threadTrees = trees[dirHists[dirIndex][j]].get();
+         if (!threadTrees) continue;
+
+         // slots are added by the threads that fill the trees
+         std::lock_guard<std::mutex> lock(threadTrees->slotsMutex);
+         std::size_t nBytes = 0;
+         for (ThreadTrees::Slot& slot : threadTrees->slots) nBytes += slot.file->GetSize();
+
+         MemoryEntry entry;
+         entry.type = "TTree";
+         entry.dirIndex = dirIndex;
+         entry.name = dirHistNames[dirIndex][j];
+         entry.nCopies = threadTrees->slots.size();
+         entry.bytesPerCopy = (entry.nCopies > 0) ? nBytes/entry.nCopies : 0;
+         entry.isPerThread = false;
+         entries.push_back(entry);
+      }
+   }
+}
+
+std::vector<ROOTTools::ThrObjHolder::Holder::MemoryEntry> 
+ROOTTools::ThrObjHolder::Holder::GetMemoryEntries(const bool sizeModels)
+{
+   std::lock_guard<std::mutex> lock(registryMutex);
+
+   std::vector<MemoryEntry> entries;
+   for (std::unique_ptr<ContainerBase>& container : containers) 
+   {
+      container->AddMemoryEntries(entries, sizeModels);
+   }
+   return entries;
+}
+
+std::size_t ROOTTools::ThrObjHolder::Holder::GetProjectedBytes(const MemoryEntry& entry, 
+                                                               const unsigned int nThreads)
+{
+   if (entry.isPerThread) return entry.bytesPerCopy*nThreads;
+   return entry.bytesPerCopy*entry.nCopies;
+}
+
+std::size_t ROOTTools::ThrObjHolder::Holder::EstimateMemory(const unsigned int nThreads)
+{
+   const unsigned int nProjectedThreads = 
+      (nThreads == 0) ? std::thread::hardware_concurrency() : nThreads;
+
+   std::size_t nBytes = 0;
+   std::size_t maxBytesPerCopy = 0;
+   for (const MemoryEntry& entry : GetMemoryEntries(true))
+   {
+      nBytes += GetProjectedBytes(entry, nProjectedThreads);
+      maxBytesPerCopy = std::max(maxBytesPerCopy, entry.bytesPerCopy);
+   }
+   // serialization and compression buffers of the histogram that is being written
+   return nBytes + 2*maxBytesPerCopy;
+}
+
+void ROOTTools::ThrObjHolder::Holder::Report(const unsigned int nThreads, const std::size_t nLargest)
+{
+   const unsigned int nProjectedThreads = 
+      (nThreads == 0) ? std::thread::hardware_concurrency() : nThreads;
+
+   const std::vector<MemoryEntry> entries = GetMemoryEntries(false);
+
+   // sums of objects of one group
+   struct Group
+   {
+      std::string name;
+      std::size_t nObjects = 0;
+      std::size_t bytesPerCopy = 0;
+      std::size_t nCopies = 0;
+      std::size_t allocatedBytes = 0;
+      std::size_t projectedBytes = 0;
+   };
+
+   std::vector<Group> types;
+   std::vector<Group> dirs;
+   {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      dirs.resize(containerTFileDir.size() + 1);
+      dirs.front().name = "/";
+      for (std::size_t i = 0; i < containerTFileDir.size(); i++) dirs[i + 1].name = containerTFileDir[i];
+   }
+
+   Group total;
+   total.name = "total";
+   std::size_t maxBytesPerCopy = 0;
+
+   for (const MemoryEntry& entry : entries)
+   {
+      // types are listed in the order in which they appear
+      auto type = std::find_if(types.begin(), types.end(), 
+                               [&](const Group& group) { return group.name == entry.type; });
+      if (type == types.end()) 
+      {
+         types.emplace_back();
+         types.back().name = entry.type;
+         type = types.end() - 1;
+      }
+
+      for (Group *group : {&*type, &dirs[entry.dirIndex], &total})
+      {
+         group->nObjects++;
+         group->bytesPerCopy += entry.bytesPerCopy;
+         group->nCopies += entry.nCopies;
+         group->allocatedBytes += entry.bytesPerCopy*entry.nCopies;
+         group->projectedBytes += GetProjectedBytes(entry, nProjectedThreads);
+      }
+      maxBytesPerCopy = std::max(maxBytesPerCopy, entry.bytesPerCopy);
+   }
+
+   auto printGroups = [](const std::vector<Group>& groups)
+   {
+      for (const Group& group : groups)
+      {
+         if (group.nObjects == 0) continue;
+         std::cout << "   " << std::left << std::setw(32) << group.name << std::right << 
+                      std::setw(9) << group.nObjects << 
+                      std::setw(14) << FormatBytes(group.bytesPerCopy) << 
+                      std::setw(9) << group.nCopies << 
+                      std::setw(14) << FormatBytes(group.allocatedBytes) << 
+                      std::setw(14) << FormatBytes(group.projectedBytes) << std::endl;
+      }
+   };
+   auto printHeader = [](const std::string& title)
+   {
+      std::cout << "   " << std::left << std::setw(32) << title << std::right << 
+                   std::setw(9) << "objects" << std::setw(14) << "1 copy" << 
+                   std::setw(9) << "copies" << std::setw(14) << "allocated" << 
+                   std::setw(14) << "projected" << std::endl;
+   };
+
+   std::cout << "ROOTTools::ThrObjHolder memory report (projected for " << 
+                nProjectedThreads << " threads)" << std::endl;
+   printHeader("type");
+   printGroups(types);
+   std::cout << std::endl;
+   printHeader("directory");
+   printGroups(dirs);
+   std::cout << std::endl;
+   printGroups({total});
+
+   std::vector<const MemoryEntry *> largest;
+   for (const MemoryEntry& entry : entries) largest.push_back(&entry);
+   std::sort(largest.begin(), largest.end(), [&](const MemoryEntry *a, const MemoryEntry *b)
+   {
+      return GetProjectedBytes(*a, nProjectedThreads) > GetProjectedBytes(*b, nProjectedThreads);
+   });
+   if (largest.size() > nLargest) largest.resize(nLargest);
+
+   std::cout << std::endl << "   largest objects:" << std::endl;
+   for (const MemoryEntry *entry : largest)
+   {
+      const std::string path = (entry->dirIndex == 0) ? entry->name : 
+         dirs[entry->dirIndex].name + "/" + entry->name;
+      std::cout << "      " << path << " (" << entry->type << "): " << 
+                   FormatBytes(entry->bytesPerCopy) << " per copy, " << entry->nCopies << 
+                   " copies allocated, " << 
+                   FormatBytes(GetProjectedBytes(*entry, nProjectedThreads)) << " projected" << std::endl;
+   }
+
+   std::cout << std::endl << "   projected peak during Write: " << 
+                FormatBytes(total.projectedBytes + 2*maxBytesPerCopy) << std::endl;
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
+                             const int xNBins, const double xLow, const double xUp,
+                             const std::string& fileDirectory, 
+                             ThrObjHolder::Holder& holder) : holder(&holder), 
+                             cacheIndex(GetCacheIndices())
+{
+   // empty histogram is created for the sum of the values moved in checkpoints
+   checkpointValues = new ThrObjHolder::CheckpointValues<T>([=]()
+   {
+      return new T(name.c_str(), title.c_str(),
+                   xNBins, xLow, xUp);
+   });
+   thrObj = holder.AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                                             xNBins, xLow, xUp), 
+                                name, fileDirectory, checkpointValues, xNBins + 2);
+   fillCounters = holder.AddFillCounters(name, fileDirectory);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
+                             const int xNBins, const double xLow, const double xUp, 
+                             const int yNBins, const double yLow, const double yUp,
+                             const std::string& fileDirectory, 
+                             ThrObjHolder::Holder& holder) : holder(&holder), 
+                             cacheIndex(GetCacheIndices())
+{
+   // empty histogram is created for the sum of the values moved in checkpoints
+   checkpointValues = new ThrObjHolder::CheckpointValues<T>([=]()
+   {
+      return new T(name.c_str(), title.c_str(),
+                   xNBins, xLow, xUp,
+                   yNBins, yLow, yUp);
+   });
+   thrObj = holder.AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                                             xNBins, xLow, xUp, 
+                                                             yNBins, yLow, yUp), 
+                                name, fileDirectory, checkpointValues, (xNBins + 2)*(yNBins + 2));
+   fillCounters = holder.AddFillCounters(name, fileDirectory);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
+                             const int xNBins, const double xLow, const double xUp, 
+                             const int yNBins, const double yLow, const double yUp,
+                             const int zNBins, const double zLow, const double zUp,
+                             const std::string& fileDirectory, 
+                             ThrObjHolder::Holder& holder) : holder(&holder), 
+                             cacheIndex(GetCacheIndices())
+{
+   // empty histogram is created for the sum of the values moved in checkpoints
+   checkpointValues = new ThrObjHolder::CheckpointValues<T>([=]()
+   {
+      return new T(name.c_str(), title.c_str(),
+                   xNBins, xLow, xUp,
+                   yNBins, yLow, yUp,
+                   zNBins, zLow, zUp);
+   });
+   thrObj = holder.AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                                             xNBins, xLow, xUp, 
+                                                             yNBins, yLow, yUp,
+                                                             zNBins, zLow, zUp), 
+                                name, fileDirectory, checkpointValues, 
+                                (xNBins + 2)*(yNBins + 2)*(zNBins + 2));
+   fillCounters = holder.AddFillCounters(name, fileDirectory);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
+                             const std::vector<double>& xEdges,
+                             const std::string& fileDirectory, 
+                             ThrObjHolder::Holder& holder) : holder(&holder), 
+                             cacheIndex(GetCacheIndices())
+{
+   // profiles and TEfficiency are filled only directly hence they do not use lookups
+   if constexpr (isHistogram)
+   {
+      binLookups = MakeBinLookups({BinLookup(xEdges)});
+   }
+   // empty histogram is created for the sum of the values moved in checkpoints
+   checkpointValues = new ThrObjHolder::CheckpointValues<T>([=]()
+   {
+      return new T(name.c_str(), title.c_str(),
+                   xEdges.size() - 1, xEdges.data());
+   });
+   thrObj = holder.AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                                             xEdges.size() - 1, xEdges.data()), 
+                                name, fileDirectory, checkpointValues, xEdges.size() + 1);
+   fillCounters = holder.AddFillCounters(name, fileDirectory);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
+                             const std::vector<double>& xEdges, const std::vector<double>& yEdges,
+                             const std::string& fileDirectory, 
+                             ThrObjHolder::Holder& holder) : holder(&holder), 
+                             cacheIndex(GetCacheIndices())
+{
+   // profiles and TEfficiency are filled only directly hence they do not use lookups
+   if constexpr (isHistogram)
+   {
+      binLookups = MakeBinLookups({BinLookup(xEdges), BinLookup(yEdges)});
+   }
+   // empty histogram is created for the sum of the values moved in checkpoints
+   checkpointValues = new ThrObjHolder::CheckpointValues<T>([=]()
+   {
+      return new T(name.c_str(), title.c_str(),
+                   xEdges.size() - 1, xEdges.data(),
+                   yEdges.size() - 1, yEdges.data());
+   });
+   thrObj = holder.AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                                             xEdges.size() - 1, xEdges.data(), 
+                                                             yEdges.size() - 1, yEdges.data()), 
+                                name, fileDirectory, checkpointValues, 
+                                (xEdges.size() + 1)*(yEdges.size() + 1));
+   fillCounters = holder.AddFillCounters(name, fileDirectory);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
+                             const std::vector<double>& xEdges, const std::vector<double>& yEdges,
+                             const std::vector<double>& zEdges,
+                             const std::string& fileDirectory, 
+                             ThrObjHolder::Holder& holder) : holder(&holder), 
+                             cacheIndex(GetCacheIndices())
+{
+   // profiles and TEfficiency are filled only directly hence they do not use lookups
+   if constexpr (isHistogram)
+   {
+      binLookups = MakeBinLookups({BinLookup(xEdges), BinLookup(yEdges), BinLookup(zEdges)});
+   }
+   // empty histogram is created for the sum of the values moved in checkpoints
+   checkpointValues = new ThrObjHolder::CheckpointValues<T>([=]()
+   {
+      return new T(name.c_str(), title.c_str(),
+                   xEdges.size() - 1, xEdges.data(),
+                   yEdges.size() - 1, yEdges.data(),
+                   zEdges.size() - 1, zEdges.data());
+   });
+   thrObj = holder.AddHistogram(new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                                             xEdges.size() - 1, xEdges.data(), 
+                                                             yEdges.size() - 1, yEdges.data(),
+                                                             zEdges.size() - 1, zEdges.data()), 
+                                name, fileDirectory, checkpointValues, 
+                                (xEdges.size() + 1)*(yEdges.size() + 1)*(zEdges.size() + 1));
+   fillCounters = holder.AddFillCounters(name, fileDirectory);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::ThrObj(const std::string& name, const std::string& title,
+                             const std::array<int, nDim>& nBins, const std::array<double, nDim>& low, 
+                             const std::array<double, nDim>& up, const std::string& fileDirectory,
+                             ThrObjHolder::Holder& holder) : holder(&holder), 
+                             cacheIndex(GetCacheIndices())
+{
+   ROOT::TThreadedObject<T> *newThrObj;
+   if constexpr (nDim == 1) 
+   {
+      newThrObj = new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                               nBins[0], low[0], up[0]);
+   }
+   else if constexpr (nDim == 2) 
+   {
+      newThrObj = new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                               nBins[0], low[0], up[0], 
+                                               nBins[1], low[1], up[1]);
+   }
+   else
+   {
+      newThrObj = new ROOT::TThreadedObject<T>(name.c_str(), title.c_str(), 
+                                               nBins[0], low[0], up[0], 
+                                               nBins[1], low[1], up[1],
+                                               nBins[2], low[2], up[2]);
+   }
+   // empty histogram is created for the sum of the values moved in checkpoints
+   checkpointValues = new ThrObjHolder::CheckpointValues<T>([=]()
+   {
+      if constexpr (nDim == 1) return new T(name.c_str(), title.c_str(), nBins[0], low[0], up[0]);
+      else if constexpr (nDim == 2)
+      {
+         return new T(name.c_str(), title.c_str(),
+                      nBins[0], low[0], up[0], nBins[1], low[1], up[1]);
+      }
+      else
+      {
+         return new T(name.c_str(), title.c_str(),
+                      nBins[0], low[0], up[0], nBins[1], low[1], up[1], nBins[2], low[2], up[2]);
+      }
+   });
+   std::size_t nCells = 1;
+   for (const int axisNBins : nBins) nCells *= axisNBins + 2;
+   thrObj = holder.AddHistogram(newThrObj, name, fileDirectory, checkpointValues, nCells);
+   fillCounters = holder.AddFillCounters(name, fileDirectory);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::BinLookup::BinLookup(const std::vector<double>& edges) : edges(edges)
+{
+   // invalid edges are left to T which reports them; ThrObj then does not use lookups
+   bool isIncreasing = edges.size() >= 2;
+   for (std::size_t i = 1; i < edges.size(); i++) 
+   {
+      isIncreasing = isIncreasing && edges[i - 1] < edges[i];
+   }
+   if (!isIncreasing)
+   {
+      std::cout << "\033[1m\033[35mWarning:\033[0m Less than 2 edges of bins or edges that are not "\
+                   "in increasing order were passed to the constructor of ROOTTools::ThrObj<T>; "\
+                   "bins will be found by T" << std::endl;
+      nBins = 0;
+      return;
+   }
+   nBins = static_cast<int>(edges.size()) - 1;
+
+   double minWidth = edges.back() - edges.front();
+   for (int i = 0; i < nBins; i++) minWidth = std::min(minWidth, edges[i + 1] - edges[i]);
+
+   // cells not wider than the narrowest bin contain at most one edge hence the bin is found 
+   // with one comparison; the number of cells is limited for axes with very different widths 
+   // of bins in which case a few more comparisons may be needed
+   const double maxNCells = 16.*nBins;
+   const int nCells = static_cast<int>(std::min(std::ceil((edges.back() - edges.front())/minWidth), 
+                                                maxNCells));
+   cellScale = nCells/(edges.back() - edges.front());
+
+   cellBins.resize(nCells);
+   int bin = 1;
+   for (int i = 0; i < nCells; i++)
+   {
+      const double cellLow = edges.front() + i/cellScale;
+      while (bin < nBins && cellLow >= edges[bin]) bin++;
+      cellBins[i] = bin;
+   }
+}
+
+template<typename T>
+typename ROOTTools::ThrObj<T>::BinLookups 
+ROOTTools::ThrObj<T>::MakeBinLookups(const std::array<BinLookup, nDim>& lookups)
+{
+   // without the lookup of one axis T finds bins on all of them
+   for (const BinLookup& lookup : lookups)
+   {
+      if (lookup.nBins == 0) return nullptr;
+   }
+   return std::make_shared<const std::array<BinLookup, nDim>>(lookups);
+}
+
+template<typename T>
+int ROOTTools::ThrObj<T>::BinLookup::FindBin(const double x) const
+{
+   // same order of comparisons as in TAxis::FindFixBin so that NaN ends up in the overflow bin
+   if (x < edges.front()) return 0;
+   if (!(x < edges.back())) return nBins + 1;
+
+   const int cell = std::min(static_cast<int>((x - edges.front())*cellScale), 
+                             static_cast<int>(cellBins.size()) - 1);
+   int bin = cellBins[cell];
+   // the loops do one step at most unless the number of cells was limited; 
+   // they also correct rounding of the cell index near the edges of the cells
+   while (x >= edges[bin]) bin++;
+   while (x < edges[bin - 1]) bin--;
+   return bin;
+}
+
+template<typename T>
+ROOTTools::ThrObjHolder::CacheIndices& ROOTTools::ThrObj<T>::GetCacheIndices()
+{
+   // created on the first use so that ThrObj objects with static storage duration can use it
+   static ThrObjHolder::CacheIndices cacheIndices;
+   return cacheIndices;
+}
+
+template<typename T>
+typename ROOTTools::ThrObj<T>::ThreadCache& ROOTTools::ThrObj<T>::GetThreadCache()
+{
+   // caches of the calling thread for every ThrObj<T> indexed by cacheIndex
+   thread_local std::vector<ThreadCache> threadCache;
+
+   if (cacheIndex.index >= threadCache.size()) threadCache.resize(cacheIndex.index + 1);
+   ThreadCache& cache = threadCache[cacheIndex.index];
+   // entry was left by the destroyed object that had the same index
+   if (cache.id != cacheIndex.id)
+   {
+      cache = ThreadCache();
+      cache.id = cacheIndex.id;
+   }
+   // the new checkpoint was started after the previous fill of the thread
+   if (cache.participant && cache.epoch != holder->GetCheckpointEpoch()) SwitchSides(cache);
+   return cache;
+}
+
+template<typename T>
+template<typename Object>
+void ROOTTools::ThrObj<T>::Participate(ThreadCache& cache, Object *current, Object *spare,
+                                       const std::function<void(T *, Object *)>& moveValues,
+                                       const std::shared_ptr<T>& spareHist)
+{
+   if (!cache.participant)
+   {
+      cache.epoch = holder->GetCheckpointEpoch();
+      cache.participant = &checkpointValues->AddParticipant(cache.epoch);
+   }
+   std::array<Object *, 2> sides;
+   sides[cache.participant->side] = current;
+   sides[1 - cache.participant->side] = spare;
+   checkpointValues->AddValues(*cache.participant, [sides, moveValues](T *target, const unsigned int side)
+   {
+      moveValues(target, sides[side]);
+   }, spareHist);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SwitchSides(ThreadCache& cache)
+{
+   // side that is switched to was emptied by the previous checkpoint which finished before 
+   // the epoch was incremented; the fence makes its writes visible to this thread
+   std::atomic_thread_fence(std::memory_order_acquire);
+   cache.epoch = holder->GetCheckpointEpoch();
+
+   if constexpr (isHistogram)
+   {
+      // values that are not in the copy yet are moved into it so that the side is complete
+      if (cache.buffer) cache.buffer->Flush();
+      if (cache.directStats) cache.directStats->Flush();
+
+      if (cache.spare.atomicStats) std::swap(cache.atomicStats, cache.spare.atomicStats);
+      if (cache.spare.sparseTable) std::swap(cache.sparseTable, cache.spare.sparseTable);
+      if (cache.spare.compactCounters) std::swap(cache.compactCounters, cache.spare.compactCounters);
+   }
+   if (cache.spare.hist) 
+   {
+      std::swap(cache.hist, cache.spare.hist);
+      if constexpr (isHistogram)
+      {
+         if (cache.buffer) cache.buffer->hist = cache.hist;
+         if (cache.directStats) cache.directStats->hist = cache.hist;
+      }
+   }
+
+   cache.participant->side = 1 - cache.participant->side;
+   // the checkpoint thread reads the side that was left only after it sees the epoch
+   cache.participant->epoch.store(cache.epoch, std::memory_order_release);
+}
+
+template<typename T>
+ROOTTools::ThrObjHolder::FillCounter& ROOTTools::ThrObj<T>::GetFillCounter()
+{
+   ThreadCache& cache = GetThreadCache();
+   if (!cache.fillCounter) cache.fillCounter = &fillCounters->AddCounter();
+   return *cache.fillCounter;
+}
+
+template<typename T>
+std::shared_ptr<T> ROOTTools::ThrObj<T>::Get()
+{
+   // copy is allocated and its slot is found in GetRaw
+   T *hist = GetRaw();
+   ThreadCache& cache = GetThreadCache();
+   // after odd number of checkpoints the thread fills its spare copy which is not in the slot
+   if (cache.participant && cache.participant->spareHist.get() == hist) return cache.participant->spareHist;
+   return thrObj->GetAtSlotUnchecked(cache.slot);
+}
+
+template<typename T>
+T *ROOTTools::ThrObj<T>::GetRaw()
+{
+   ThreadCache& cache = GetThreadCache();
+   if (cache.hist) return cache.hist;
+
+   // TThreadedObject does not expose the slot of the calling thread hence every thread 
+   // takes the next slot that was not taken by another thread
+   cache.slot = (*nextSlot)++;
+   if (cache.slot >= thrObj->GetNSlots())
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Histogram is filled on more threads than " << 
+                   "the number of slots of TThreadedObject (" << thrObj->GetNSlots() << 
+                   ") in ROOTTools::ThrObj<T>::GetRaw(); see ROOTTools::ThrObj<T>::Get(slot)" << std::endl;
+      exit(1);
+   }
+
+   T *hist = nullptr;
+   // bins of TEfficiency are in its histograms hence they can not be placed in the arena
+   if constexpr (std::is_base_of<TH1, T>::value)
+   {
+      if (holder->IsArenaEnabled()) hist = CreateArenaSlot(cache.slot);
+   }
+   if (!hist) hist = thrObj->GetAtSlot(cache.slot).get();
+   cache.hist = hist;
+   // copy is only the target of Flush in Write in these modes hence its values 
+   // are never moved in checkpoints
+   if (holder->AreCheckpointsEnabled() && 
+       fillMode != FillMode::SharedAtomic && fillMode != FillMode::Sparse)
+   {
+      // the copy is empty since it was just allocated, hence its clone is the empty second side
+      std::shared_ptr<T> spareHist(static_cast<T *>(hist->Clone()));
+      ThrObjHolder::Detach(spareHist.get());
+      cache.spare.hist = spareHist.get();
+      Participate<T>(cache, hist, spareHist.get(), [](T *target, T *side)
+      {
+         ThrObjHolder::AddObject(target, side);
+         ThrObjHolder::ResetObject(side);
+      }, spareHist);
+   }
+   return cache.hist;
+}
+
+template<typename T>
+T *ROOTTools::ThrObj<T>::CreateArenaSlot(const unsigned int slot)
+{
+   // copy is constructed from the same arguments as the model of TThreadedObject instead of 
+   // being cloned from it, and its zero-initialized array of contents is adopted from the arena
+   T *hist = checkpointValues->createEmpty();
+   ThrObjHolder::Detach(hist);
+   std::shared_ptr<void> contents = holder->AllocateInArena(hist->GetNcells()*sizeof(ContentType));
+   hist->Adopt(hist->GetNcells(), static_cast<ContentType *>(contents.get()));
+
+   thrObj->SetAtSlot(slot, std::shared_ptr<T>(hist, [contents](T *arenaHist)
+   {
+      // TArray can not release its array without deleting it hence the pointer is cleared first;
+      // contents keep the arena until then
+      arenaHist->fArray = nullptr;
+      delete arenaHist;
+   }));
+   return hist;
+}
+
+template<typename T>
+std::shared_ptr<T> ROOTTools::ThrObj<T>::Get(const unsigned int slot)
+{
+   if (slot >= thrObj->GetNSlots())
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Slot " << slot << 
+                   " is out of range in ROOTTools::ThrObj<T>::Get(slot): number of slots is " << 
+                   thrObj->GetNSlots() << std::endl;
+      exit(1);
+   }
+   // copy is allocated if the slot is empty
+   return thrObj->GetAtSlot(slot);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FillN(std::span<const double> x, std::span<const double> w)
+{
+   FillNImpl({x}, w);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FillN(std::span<const double> x, std::span<const double> y, 
+                                 std::span<const double> w)
+{
+   FillNImpl({x, y}, w);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FillN(std::span<const double> x, std::span<const double> y, 
+                                 std::span<const double> z, std::span<const double> w)
+{
+   FillNImpl({x, y, z}, w);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FindFixedBins(const double *x, const int nBins, 
+                                         const double xMin, const double xMax, int *bins)
+{
+   const double nBinsD = static_cast<double>(nBins);
+   for (std::size_t i = 0; i < fillNBlockSize; i++)
+   {
+      // same expression as in TAxis::FindBin so that values on bin edges end up in the same bins;
+      // clamping is done in floating point before the conversion so that it never overflows
+      // and the order of clamping sends NaN to the overflow bin as TAxis::FindBin does
+      double bin = nBinsD*(x[i] - xMin)/(xMax - xMin);
+      bin = (bin < nBinsD) ? bin : nBinsD;
+      bin = (bin >= 0.) ? bin : -1.;
+      bins[i] = 1 + static_cast<int>(bin);
+   }
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FillNImpl(const std::array<std::span<const double>, nDim>& coords, 
+                                     std::span<const double> w)
+{
+   const std::size_t n = coords[0].size();
+   for (std::size_t i = 1; i < nDim; i++)
+   {
+      if (coords[i].size() != n)
+      {
+         std::cout << "\033[1m\033[31mError:\033[0m Sizes of coordinate arrays are inconsistent "\
+                      "in ROOTTools::ThrObj<T>::FillN" << std::endl;
+         exit(1);
+      }
+   }
+   if (!w.empty() && w.size() != n)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Size of weights array is inconsistent "\
+                   "with the size of coordinate arrays in ROOTTools::ThrObj<T>::FillN" << std::endl;
+      exit(1);
+   }
+
+   // FillN is called for many values at once hence every call is timed
+   ThrObjHolder::FillCounter *counter = fillCounters ? &GetFillCounter() : nullptr;
+   std::chrono::steady_clock::time_point start;
+   if (counter) start = std::chrono::steady_clock::now();
+
+   if (fillMode == FillMode::SharedAtomic || fillMode == FillMode::Sparse || 
+       fillMode == FillMode::Compact)
+   {
+      std::array<double, nDim + 1> values;
+      for (std::size_t i = 0; i < n; i++)
+      {
+         for (std::size_t j = 0; j < nDim; j++) values[j] = coords[j][i];
+         values[nDim] = w.empty() ? 1. : w[i];
+         StorageFill(values);
+      }
+   }
+   else FillHistN(GetRaw(), coords, w, binLookups);
+
+   if (counter)
+   {
+      const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+      counter->nFills += n;
+      counter->nTimedFills += n;
+      counter->timedSeconds += duration.count();
+   }
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FillHistN(T *hist, 
+                                     const std::array<std::span<const double>, nDim>& coords, 
+                                     std::span<const double> w, const BinLookups& binLookups)
+{
+   const std::size_t n = coords[0].size();
+
+   const std::array<TAxis *, 3> axes = {hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis()};
+
+   bool isFixedBinning = (hist->GetBuffer() == nullptr);
+   for (std::size_t i = 0; i < nDim; i++)
+   {
+      // variable width axes are supported only with lookups that were created for them
+      const bool hasBinLookup = binLookups && (*binLookups)[i].nBins == axes[i]->GetNbins();
+      if ((axes[i]->GetXbins()->fN != 0 && !hasBinLookup) || axes[i]->CanExtend() || 
+          axes[i]->TestBit(TAxis::kAxisRange)) isFixedBinning = false;
+   }
+
+   if (!isFixedBinning)
+   {
+      for (std::size_t i = 0; i < n; i++)
+      {
+         const double weight = w.empty() ? 1. : w[i];
+         if constexpr (nDim == 1) hist->Fill(coords[0][i], weight);
+         else if constexpr (nDim == 2) hist->Fill(coords[0][i], coords[1][i], weight);
+         else hist->Fill(coords[0][i], coords[1][i], coords[2][i], weight);
+      }
+      return;
+   }
+
+   // TH1::Fill creates the array of sum of squares of weights on the first weight that is not 1
+   if (hist->GetSumw2N() == 0 && !hist->TestBit(TH1::kIsNotW))
+   {
+      for (const double weight : w) 
+      {
+         if (weight != 1.) 
+         {
+            hist->Sumw2();
+            break;
+         }
+      }
+   }
+
+   std::array<int, nDim> nBins;
+   std::array<double, nDim> min, max;
+   for (std::size_t i = 0; i < nDim; i++)
+   {
+      nBins[i] = axes[i]->GetNbins();
+      min[i] = axes[i]->GetXmin();
+      max[i] = axes[i]->GetXmax();
+   }
+
+   auto *contents = hist->GetArray();
+   double *sumw2 = (hist->GetSumw2N() > 0) ? hist->GetSumw2()->GetArray() : nullptr;
+   const bool statOverflows = hist->GetStatOverflowsBehaviour();
+
+   double stats[TH1::kNstat] = {};
+   hist->GetStats(stats);
+
+   std::array<std::array<int, fillNBlockSize>, nDim> bins;
+   std::array<double, fillNBlockSize> tail;
+
+   for (std::size_t begin = 0; begin < n; begin += fillNBlockSize)
+   {
+      const std::size_t blockSize = std::min(fillNBlockSize, n - begin);
+
+      for (std::size_t i = 0; i < nDim; i++)
+      {
+         const double *x = coords[i].data() + begin;
+         if (binLookups)
+         {
+            const BinLookup& binLookup = (*binLookups)[i];
+            for (std::size_t j = 0; j < blockSize; j++) bins[i][j] = binLookup.FindBin(x[j]);
+            continue;
+         }
+         // the last incomplete block is padded so that the vectorized loop can be used for it too
+         if (blockSize < fillNBlockSize)
+         {
+            tail.fill(min[i]);
+            std::copy(x, x + blockSize, tail.begin());
+            x = tail.data();
+         }
+         FindFixedBins(x, nBins[i], min[i], max[i], bins[i].data());
+      }
+
+      // contents and statistics are accumulated in the same order as in TH1::Fill, 
+      // TH2::Fill, and TH3::Fill so that the results are identical
+      for (std::size_t j = 0; j < blockSize; j++)
+      {
+         const double weight = w.empty() ? 1. : w[begin + j];
+
+         int bin = bins[nDim - 1][j];
+         bool isInRange = (bins[nDim - 1][j] != 0 && bins[nDim - 1][j] <= nBins[nDim - 1]);
+         for (int i = static_cast<int>(nDim) - 2; i >= 0; i--)
+         {
+            bin = bin*(nBins[i] + 2) + bins[i][j];
+            isInRange = isInRange && bins[i][j] != 0 && bins[i][j] <= nBins[i];
+         }
+
+         AddBinContent(hist, contents, bin, weight);
+         if (sumw2) sumw2[bin] += weight*weight;
+
+         if (!isInRange && !statOverflows) continue;
+
+         const double x = coords[0][begin + j];
+         stats[0] += weight;
+         stats[1] += weight*weight;
+         stats[2] += weight*x;
+         stats[3] += weight*x*x;
+         if constexpr (nDim > 1)
+         {
+            const double y = coords[1][begin + j];
+            stats[4] += weight*y;
+            stats[5] += weight*y*y;
+            stats[6] += weight*x*y;
+            if constexpr (nDim > 2)
+            {
+               const double z = coords[2][begin + j];
+               stats[7] += weight*z;
+               stats[8] += weight*z*z;
+               stats[9] += weight*x*z;
+               stats[10] += weight*y*z;
+            }
+         }
+      }
+   }
+
+   hist->PutStats(stats);
+   hist->SetEntries(hist->GetEntries() + static_cast<double>(n));
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::FillBuffer::FillBuffer(T *hist, const std::size_t bufferSize, 
+                                             const BinLookups& binLookups) : 
+   hist(hist), binLookups(binLookups)
+{
+   for (std::vector<double>& axisCoords : coords) axisCoords.resize(bufferSize);
+   w.resize(bufferSize);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FillBuffer::Flush()
+{
+   if (size == 0) return;
+
+   std::array<std::span<const double>, nDim> coordsSpans;
+   for (std::size_t i = 0; i < nDim; i++) coordsSpans[i] = std::span<const double>(coords[i].data(), size);
+   FillHistN(hist, coordsSpans, std::span<const double>(w.data(), size), binLookups);
+
+   size = 0;
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FillBuffer::Reset()
+{
+   size = 0;
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SetFillMode(const FillMode mode)
+{
+   if (fillMode != FillMode::Direct && fillMode != mode)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Fill buffer, shared atomic bins, sparse, "\
+                   "and compact counters modes cannot be combined in ROOTTools::ThrObj<T>" << std::endl;
+      exit(1);
+   }
+   fillMode = mode;
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SetFillBuffer(const std::size_t bufferSize)
+{
+   if (bufferSize == 0)
+   {
+      if (fillMode == FillMode::Buffered) fillMode = FillMode::Direct;
+   }
+   else SetFillMode(FillMode::Buffered);
+   fillBufferSize = bufferSize;
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::FlushFillBuffer()
+{
+   ThreadCache& cache = GetThreadCache();
+   if (cache.buffer) cache.buffer->Flush();
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::StorageFill(const std::array<double, nDim + 1>& values)
+{
+   ThreadCache& cache = GetThreadCache();
+
+   if (fillMode == FillMode::Buffered)
+   {
+      if (!cache.buffer)
+      {
+         cache.buffer = new FillBuffer(GetRaw(), fillBufferSize, binLookups);
+         holder->AddFlushable(cache.buffer);
+      }
+
+      FillBuffer& buffer = *cache.buffer;
+      for (std::size_t i = 0; i < nDim; i++) buffer.coords[i][buffer.size] = values[i];
+      buffer.w[buffer.size] = values[nDim];
+
+      if (++buffer.size == buffer.w.size()) buffer.Flush();
+   }
+   else if (fillMode == FillMode::SharedAtomic)
+   {
+      if constexpr (nDim == 1)
+      {
+         if (!cache.atomicStats) 
+         {
+            cache.atomicStats = &atomicBins->AddStats();
+            if (holder->AreCheckpointsEnabled())
+            {
+               cache.spare.atomicStats = &atomicBins->AddStats();
+               Participate<typename AtomicBins::Stats>(cache, cache.atomicStats, cache.spare.atomicStats, 
+                                                        [](T *target, typename AtomicBins::Stats *side)
+               {
+                  AtomicBins::AddStatsTo(target, *side);
+                  *side = typename AtomicBins::Stats();
+               });
+            }
+         }
+         atomicBins->Fill(*cache.atomicStats, values[0], values[1]);
+      }
+   }
+   else if (fillMode == FillMode::Sparse)
+   {
+      if constexpr (nDim > 1)
+      {
+         if (!cache.sparseTable) 
+         {
+            cache.sparseTable = &sparseBins->AddTable();
+            if (holder->AreCheckpointsEnabled())
+            {
+               cache.spare.sparseTable = &sparseBins->AddTable();
+               Participate<typename SparseBins::Table>(cache, cache.sparseTable, cache.spare.sparseTable, 
+                                                        [](T *target, typename SparseBins::Table *side)
+               {
+                  SparseBins::AddTablesTo(target, {side});
+                  *side = typename SparseBins::Table();
+               });
+            }
+         }
+         sparseBins->Fill(*cache.sparseTable, values);
+      }
+   }
+   else if (fillMode == FillMode::Compact)
+   {
+      // counters only count entries hence weighted values are filled into the copy of the thread
+      if (values[nDim] != 1.)
+      {
+         if constexpr (nDim == 1) GetRaw()->Fill(values[0], values[1]);
+         else if constexpr (nDim == 2) GetRaw()->Fill(values[0], values[1], values[2]);
+         else GetRaw()->Fill(values[0], values[1], values[2], values[3]);
+         return;
+      }
+
+      if (!cache.compactCounters) 
+      {
+         cache.compactCounters = &compactBins->AddCounters();
+         if (holder->AreCheckpointsEnabled())
+         {
+            cache.spare.compactCounters = &compactBins->AddCounters();
+            Participate<typename CompactBins::Counters>(cache, cache.compactCounters, 
+                                                         cache.spare.compactCounters, 
+                                                         [compactBins = compactBins]
+                                                         (T *target, typename CompactBins::Counters *side)
+            {
+               compactBins->AddCountersTo(target, {side});
+               side->Reset();
+            });
+         }
+      }
+      const int overflowBin = compactBins->Fill(*cache.compactCounters, values);
+      if (overflowBin >= 0) 
+      {
+         T *hist = GetRaw();
+         AddBinContent(hist, hist->GetArray(), overflowBin, UINT32_MAX);
+         if (hist->GetSumw2N() > 0) hist->GetSumw2()->GetArray()[overflowBin] += UINT32_MAX;
+      }
+   }
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::AtomicBins::AtomicBins(T *hist, const BinLookups& binLookups) : 
+   hist(hist), axis(*hist->GetXaxis()), binLookups(binLookups)
+{
+   statOverflows = hist->GetStatOverflowsBehaviour();
+   contents.reset(new std::atomic<ContentType>[axis.GetNbins() + 2]);
+   sumw2.reset(new std::atomic<double>[axis.GetNbins() + 2]);
+   for (int i = 0; i < axis.GetNbins() + 2; i++)
+   {
+      contents[i].store(0, std::memory_order_relaxed);
+      sumw2[i].store(0., std::memory_order_relaxed);
+   }
+}
+
+template<typename T>
+typename ROOTTools::ThrObj<T>::AtomicBins::Stats& ROOTTools::ThrObj<T>::AtomicBins::AddStats()
+{
+   std::lock_guard<std::mutex> lock(statsMutex);
+   return stats.emplace_back();
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::AtomicBins::Fill(Stats& threadStats, const double x, const double w)
+{
+   const int bin = binLookups ? (*binLookups)[0].FindBin(x) : axis.FindFixBin(x);
+
+   if constexpr (std::is_integral<ContentType>::value)
+   {
+      contents[bin].fetch_add(static_cast<ContentType>(w), std::memory_order_relaxed);
+   }
+   else
+   {
+      // std::atomic<float> and std::atomic<double> have no fetch_add until C++20
+      ContentType expected = contents[bin].load(std::memory_order_relaxed);
+      while (!contents[bin].compare_exchange_weak(expected, 
+                                                  expected + static_cast<ContentType>(w),
+                                                  std::memory_order_relaxed));
+   }
+   double expected = sumw2[bin].load(std::memory_order_relaxed);
+   while (!sumw2[bin].compare_exchange_weak(expected, expected + w*w, std::memory_order_relaxed));
+
+   threadStats.entries++;
+   if (w != 1.) threadStats.isWeighted = true;
+   if ((bin == 0 || bin > axis.GetNbins()) && !statOverflows) return;
+
+   threadStats.sumw += w;
+   threadStats.sumw2 += w*w;
+   threadStats.sumwx += w*x;
+   threadStats.sumwx2 += w*x*x;
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::AtomicBins::Flush()
+{
+   bool isWeighted = false;
+   double entries = 0.;
+   double histStats[TH1::kNstat] = {};
+   hist->GetStats(histStats);
+   for (Stats& threadStats : stats)
+   {
+      histStats[0] += threadStats.sumw;
+      histStats[1] += threadStats.sumw2;
+      histStats[2] += threadStats.sumwx;
+      histStats[3] += threadStats.sumwx2;
+      entries += threadStats.entries;
+      isWeighted = isWeighted || threadStats.isWeighted;
+      threadStats = Stats();
+   }
+
+   // same as in TH1::Fill: the array of sum of squares of weights is created 
+   // only if it was requested or if weight that is not 1 was filled
+   if (isWeighted && hist->GetSumw2N() == 0 && !hist->TestBit(TH1::kIsNotW)) hist->Sumw2();
+
+   typename ThrObj::ContentType *histContents = hist->GetArray();
+   double *histSumw2 = (hist->GetSumw2N() > 0) ? hist->GetSumw2()->GetArray() : nullptr;
+   for (int i = 0; i < axis.GetNbins() + 2; i++)
+   {
+      AddBinContent(hist, histContents, i, contents[i].exchange(0, std::memory_order_relaxed));
+      const double binSumw2 = sumw2[i].exchange(0., std::memory_order_relaxed);
+      if (histSumw2) histSumw2[i] += binSumw2;
+   }
+
+   hist->PutStats(histStats);
+   hist->SetEntries(hist->GetEntries() + entries);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::AtomicBins::Reset()
+{
+   for (Stats& threadStats : stats) threadStats = Stats();
+   for (int i = 0; i < axis.GetNbins() + 2; i++)
+   {
+      contents[i].store(0, std::memory_order_relaxed);
+      sumw2[i].store(0., std::memory_order_relaxed);
+   }
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::AtomicBins::AddStatsTo(T *target, const Stats& threadStats)
+{
+   // same as in TH1::Fill: the array of sum of squares of weights is created 
+   // only if it was requested or if weight that is not 1 was filled
+   if (threadStats.isWeighted && target->GetSumw2N() == 0 && !target->TestBit(TH1::kIsNotW)) 
+   {
+      target->Sumw2();
+   }
+
+   double histStats[TH1::kNstat] = {};
+   target->GetStats(histStats);
+   histStats[0] += threadStats.sumw;
+   histStats[1] += threadStats.sumw2;
+   histStats[2] += threadStats.sumwx;
+   histStats[3] += threadStats.sumwx2;
+   target->PutStats(histStats);
+   target->SetEntries(target->GetEntries() + threadStats.entries);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::AtomicBins::AddBinsTo(T *target) const
+{
+   typename ThrObj::ContentType *histContents = target->GetArray();
+   double *histSumw2 = (target->GetSumw2N() > 0) ? target->GetSumw2()->GetArray() : nullptr;
+   for (int i = 0; i < axis.GetNbins() + 2; i++)
+   {
+      AddBinContent(target, histContents, i, contents[i].load(std::memory_order_relaxed));
+      if (histSumw2) histSumw2[i] += sumw2[i].load(std::memory_order_relaxed);
+   }
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SetSharedAtomicBins()
+{
+   if (atomicBins) return;
+   SetFillMode(FillMode::SharedAtomic);
+
+   T *hist = GetRaw();
+   if (hist->GetXaxis()->CanExtend() || hist->GetBuffer())
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Histogram \"" << hist->GetName() << 
+                   "\" has extendable axis or buffer which are not supported in "\
+                   "ROOTTools::ThrObj<T>::SetSharedAtomicBins" << std::endl;
+      exit(1);
+   }
+
+   atomicBins = new AtomicBins(hist, binLookups);
+   holder->AddFlushable(atomicBins);
+
+   std::lock_guard<std::mutex> lock(checkpointValues->mutex);
+   checkpointValues->addShared = [atomicBins = atomicBins](T *target)
+   {
+      atomicBins->AddBinsTo(target);
+   };
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::SparseBins::Table::Table()
+{
+   entries.resize(16);
+}
+
+template<typename T>
+typename ROOTTools::ThrObj<T>::SparseBins::Entry& 
+ROOTTools::ThrObj<T>::SparseBins::Table::operator[](const int bin)
+{
+   const std::size_t mask = entries.size() - 1;
+   // Fibonacci hashing spreads neighbouring bins that are usually filled together
+   std::size_t i = (static_cast<std::size_t>(bin)*0x9E3779B97F4A7C15ull >> 17) & mask;
+   for (;; i = (i + 1) & mask)
+   {
+      if (entries[i].bin == bin) return entries[i];
+      if (entries[i].bin == -1)
+      {
+         // load factor is kept below 0.5 so that probe sequences stay short
+         if (2*(size + 1) > entries.size())
+         {
+            Grow();
+            return (*this)[bin];
+         }
+         entries[i].bin = bin;
+         size++;
+         return entries[i];
+      }
+   }
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SparseBins::Table::Grow()
+{
+   std::vector<Entry> oldEntries(2*entries.size());
+   oldEntries.swap(entries);
+   size = 0;
+   for (const Entry& entry : oldEntries)
+   {
+      if (entry.bin == -1) continue;
+      Entry& newEntry = (*this)[entry.bin];
+      newEntry.content = entry.content;
+      newEntry.sumw2 = entry.sumw2;
+   }
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::SparseBins::SparseBins(T *hist, const BinLookups& binLookups) : 
+   hist(hist), binLookups(binLookups)
+{
+   const std::array<TAxis *, 3> histAxes = {hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis()};
+   for (std::size_t i = 0; i < nDim; i++) axes[i] = *histAxes[i];
+   statOverflows = hist->GetStatOverflowsBehaviour();
+}
+
+template<typename T>
+typename ROOTTools::ThrObj<T>::SparseBins::Table& ROOTTools::ThrObj<T>::SparseBins::AddTable()
+{
+   std::lock_guard<std::mutex> lock(tablesMutex);
+   return tables.emplace_back();
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SparseBins::Fill(Table& table, const std::array<double, nDim + 1>& values)
+{
+   int bin = 0;
+   bool isInRange = true;
+   for (int i = static_cast<int>(nDim) - 1; i >= 0; i--)
+   {
+      const int axisBin = binLookups ? (*binLookups)[i].FindBin(values[i]) : 
+                                       axes[i].FindFixBin(values[i]);
+      bin = bin*(axes[i].GetNbins() + 2) + axisBin;
+      isInRange = isInRange && axisBin != 0 && axisBin <= axes[i].GetNbins();
+   }
+
+   const double w = values[nDim];
+   Entry& entry = table[bin];
+   entry.content += static_cast<ContentType>(w);
+   entry.sumw2 += w*w;
+
+   table.nEntries++;
+   if (w != 1.) table.isWeighted = true;
+   if (!isInRange && !statOverflows) return;
+
+   // same as in TH2::Fill and TH3::Fill
+   const double x = values[0];
+   const double y = values[1];
+   table.stats[0] += w;
+   table.stats[1] += w*w;
+   table.stats[2] += w*x;
+   table.stats[3] += w*x*x;
+   table.stats[4] += w*y;
+   table.stats[5] += w*y*y;
+   table.stats[6] += w*x*y;
+   if constexpr (nDim > 2)
+   {
+      const double z = values[2];
+      table.stats[7] += w*z;
+      table.stats[8] += w*z*z;
+      table.stats[9] += w*x*z;
+      table.stats[10] += w*y*z;
+   }
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SparseBins::AddTablesTo(T *target, 
+                                                   const std::vector<const Table *>& addedTables)
+{
+   bool isWeighted = false;
+   for (const Table *table : addedTables) isWeighted = isWeighted || table->isWeighted;
+
+   // same as in TH1::Fill: the array of sum of squares of weights is created 
+   // only if it was requested or if weight that is not 1 was filled
+   if (isWeighted && target->GetSumw2N() == 0 && !target->TestBit(TH1::kIsNotW)) target->Sumw2();
+
+   typename ThrObj::ContentType *histContents = target->GetArray();
+   double *histSumw2 = (target->GetSumw2N() > 0) ? target->GetSumw2()->GetArray() : nullptr;
+
+   double entries = 0.;
+   double histStats[TH1::kNstat] = {};
+   target->GetStats(histStats);
+
+   for (const Table *table : addedTables)
+   {
+      for (const Entry& entry : table->entries)
+      {
+         if (entry.bin == -1) continue;
+         AddBinContent(target, histContents, entry.bin, entry.content);
+         if (histSumw2) histSumw2[entry.bin] += entry.sumw2;
+      }
+      for (int i = 0; i < TH1::kNstat; i++) histStats[i] += table->stats[i];
+      entries += table->nEntries;
+   }
+
+   target->PutStats(histStats);
+   target->SetEntries(target->GetEntries() + entries);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SparseBins::Flush()
+{
+   std::vector<const Table *> addedTables;
+   for (const Table& table : tables) addedTables.push_back(&table);
+   AddTablesTo(hist, addedTables);
+   // tables are released since their contents are now in the histogram
+   Reset();
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SparseBins::Reset()
+{
+   for (Table& table : tables) table = Table();
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SetSparseBins()
+{
+   if (sparseBins) return;
+   SetFillMode(FillMode::Sparse);
+
+   T *hist = GetRaw();
+   const std::array<TAxis *, 3> axes = {hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis()};
+   bool canExtend = false;
+   for (std::size_t i = 0; i < nDim; i++) canExtend = canExtend || axes[i]->CanExtend();
+   if (canExtend || hist->GetBuffer())
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Histogram \"" << hist->GetName() << 
+                   "\" has extendable axis or buffer which are not supported in "\
+                   "ROOTTools::ThrObj<T>::SetSparseBins" << std::endl;
+      exit(1);
+   }
+
+   sparseBins = new SparseBins(hist, binLookups);
+   holder->AddFlushable(sparseBins);
+}
+
+template<typename T>
+ROOTTools::ThrObj<T>::CompactBins::CompactBins(T *hist, const BinLookups& binLookups) : 
+   hist(hist), binLookups(binLookups)
+{
+   const std::array<TAxis *, 3> histAxes = {hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis()};
+   nCells = 1;
+   for (std::size_t i = 0; i < nDim; i++) 
+   {
+      axes[i] = *histAxes[i];
+      nCells *= axes[i].GetNbins() + 2;
+   }
+   statOverflows = hist->GetStatOverflowsBehaviour();
+}
+
+template<typename T>
+typename ROOTTools::ThrObj<T>::CompactBins::Counters& 
+ROOTTools::ThrObj<T>::CompactBins::AddCounters()
+{
+   Counters *threadCounters;
+   {
+      std::lock_guard<std::mutex> lock(countersMutex);
+      threadCounters = &counters.emplace_back();
+   }
+   // counters are allocated on the calling thread so that they are placed in its memory
+   threadCounters->counts16.assign(nCells, 0);
+   return *threadCounters;
+}
+
+template<typename T>
+int ROOTTools::ThrObj<T>::CompactBins::Fill(Counters& threadCounters, 
+                                            const std::array<double, nDim + 1>& values)
+{
+   int bin = 0;
+   bool isInRange = true;
+   for (int i = static_cast<int>(nDim) - 1; i >= 0; i--)
+   {
+      const int axisBin = binLookups ? (*binLookups)[i].FindBin(values[i]) : 
+                                       axes[i].FindFixBin(values[i]);
+      bin = bin*(axes[i].GetNbins() + 2) + axisBin;
+      isInRange = isInRange && axisBin != 0 && axisBin <= axes[i].GetNbins();
+   }
+
+   int overflowBin = -1;
+   if (threadCounters.counts32.empty())
+   {
+      if (threadCounters.counts16[bin] != UINT16_MAX) threadCounters.counts16[bin]++;
+      else
+      {
+         // all counters of the thread are promoted since one of them would overflow
+         threadCounters.counts32.assign(threadCounters.counts16.begin(), 
+                                        threadCounters.counts16.end());
+         std::vector<std::uint16_t>().swap(threadCounters.counts16);
+      }
+   }
+   if (!threadCounters.counts32.empty())
+   {
+      if (threadCounters.counts32[bin] != UINT32_MAX) threadCounters.counts32[bin]++;
+      else
+      {
+         // full counter is moved into the copy of the histogram of the thread by the caller 
+         // and the counter keeps the current fill
+         threadCounters.counts32[bin] = 1;
+         overflowBin = bin;
+      }
+   }
+
+   threadCounters.nEntries++;
+   if (!isInRange && !statOverflows) return overflowBin;
+
+   // same as in TH1::Fill, TH2::Fill, and TH3::Fill with the weight equal to 1
+   const double x = values[0];
+   threadCounters.stats[0] += 1.;
+   threadCounters.stats[1] += 1.;
+   threadCounters.stats[2] += x;
+   threadCounters.stats[3] += x*x;
+   if constexpr (nDim > 1)
+   {
+      const double y = values[1];
+      threadCounters.stats[4] += y;
+      threadCounters.stats[5] += y*y;
+      threadCounters.stats[6] += x*y;
+      if constexpr (nDim > 2)
+      {
+         const double z = values[2];
+         threadCounters.stats[7] += z;
+         threadCounters.stats[8] += z*z;
+         threadCounters.stats[9] += x*z;
+         threadCounters.stats[10] += y*z;
+      }
+   }
+   return overflowBin;
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::CompactBins::AddCountersTo(T *target, 
+                                                      const std::vector<const Counters *>& addedCounters) const
+{
+   typename ThrObj::ContentType *histContents = target->GetArray();
+   double *histSumw2 = (target->GetSumw2N() > 0) ? target->GetSumw2()->GetArray() : nullptr;
+
+   double entries = 0.;
+   double histStats[TH1::kNstat] = {};
+   target->GetStats(histStats);
+
+   for (const Counters *threadCounters : addedCounters)
+   {
+      for (int i = 0; i < nCells; i++)
+      {
+         const std::uint32_t count = threadCounters->counts32.empty() ? 
+            threadCounters->counts16[i] : threadCounters->counts32[i];
+         if (count == 0) continue;
+         AddBinContent(target, histContents, i, count);
+         // sum of squares of unit weights is equal to the number of entries
+         if (histSumw2) histSumw2[i] += count;
+      }
+      for (int i = 0; i < TH1::kNstat; i++) histStats[i] += threadCounters->stats[i];
+      entries += threadCounters->nEntries;
+   }
+
+   target->PutStats(histStats);
+   target->SetEntries(target->GetEntries() + entries);
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::CompactBins::Flush()
+{
+   std::vector<const Counters *> addedCounters;
+   for (const Counters& threadCounters : counters) addedCounters.push_back(&threadCounters);
+   AddCountersTo(hist, addedCounters);
+   Reset();
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::CompactBins::Counters::Reset()
+{
+   // counters are zeroed in place so that they are not reallocated when the histogram is reused
+   std::fill(counts16.begin(), counts16.end(), 0);
+   std::fill(counts32.begin(), counts32.end(), 0);
+   std::fill(stats, stats + TH1::kNstat, 0.);
+   nEntries = 0.;
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::CompactBins::Reset()
+{
+   for (Counters& threadCounters : counters) threadCounters.Reset();
+}
+
+template<typename T>
+void ROOTTools::ThrObj<T>::SetCompactCounters()
+{
+   if (compactBins) return;
+   SetFillMode(FillMode::Compact);
+
+   T *hist = GetRaw();
+   const std::array<TAxis *, 3> axes = {hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis()};
+   bool canExtend = false;
+   for (std::size_t i = 0; i < nDim; i++) canExtend = canExtend || axes[i]->CanExtend();
+   if (canExtend || hist->GetBuffer())
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Histogram \"" << hist->GetName() << 
+                   "\" has extendable axis or buffer which are not supported in "\
+                   "ROOTTools::ThrObj<T>::SetCompactCounters" << std::endl;
+      exit(1);
+   }
+
+   compactBins = new CompactBins(hist, binLookups);
+   holder->AddFlushable(compactBins);
+}
+
+template<typename V>
+ROOTTools::ThrCounter<V>::ThrCounter(const std::string& name, const std::string& fileDirectory, 
+                                     ThrObjHolder::Holder& holder) : 
+   cacheIndex(GetCacheIndices())
+{
+   ROOT::TThreadedObject<TParameter<V>> *parameter = 
+      holder.AddHistogram(new ROOT::TThreadedObject<TParameter<V>>(name.c_str(), static_cast<V>(0)), 
+                          name, fileDirectory);
+   slots = new Slots(parameter);
+   holder.AddFlushable(slots);
+}
+
+template<typename V>
+ROOTTools::ThrObjHolder::CacheIndices& ROOTTools::ThrCounter<V>::GetCacheIndices()
+{
+   static ThrObjHolder::CacheIndices cacheIndices;
+   return cacheIndices;
+}
+
+template<typename V>
+typename ROOTTools::ThrCounter<V>::Slot& ROOTTools::ThrCounter<V>::GetSlot()
+{
+   // ids and slots of the calling thread for every ThrCounter<V> indexed by cacheIndex
+   thread_local std::vector<std::pair<std::uint64_t, Slot *>> threadSlots;
+
+   if (cacheIndex.index >= threadSlots.size()) threadSlots.resize(cacheIndex.index + 1, {0, nullptr});
+   std::pair<std::uint64_t, Slot *>& entry = threadSlots[cacheIndex.index];
+   // entry is empty or was left by the destroyed counter that had the same index
+   if (entry.first != cacheIndex.id) entry = {cacheIndex.id, &slots->AddSlot()};
+   return *entry.second;
+}
+
+template<typename V>
+ROOTTools::ThrCounter<V>::Slots::Slots(ROOT::TThreadedObject<TParameter<V>> *parameter) : 
+   parameter(parameter) {}
+
+template<typename V>
+typename ROOTTools::ThrCounter<V>::Slot& ROOTTools::ThrCounter<V>::Slots::AddSlot()
+{
+   std::lock_guard<std::mutex> lock(slotsMutex);
+   return slots.emplace_back();
+}
+
+template<typename V>
+void ROOTTools::ThrCounter<V>::Slots::Flush()
+{
+   V sum = 0;
+   for (const Slot& slot : slots) sum += slot.value;
+   Reset();
+
+   // the sum is added to the first copy so that the thread that flushes does not allocate its own
+   TParameter<V> *firstParameter = parameter->GetAtSlotRaw(0);
+   if (!firstParameter) firstParameter = parameter->GetAtSlot(0).get();
+   firstParameter->SetVal(firstParameter->GetVal() + sum);
+}
+
+template<typename V>
+void ROOTTools::ThrCounter<V>::Slots::Reset()
+{
+   for (Slot& slot : slots) slot.value = 0;
+}
+
+ROOTTools::ThrCutflow::ThrCutflow(const std::string& name, const std::vector<std::string>& cutNames,
+                                  const std::string& fileDirectory, ThrObjHolder::Holder& holder) : 
+   cacheIndex(GetCacheIndices())
+{
+   if (cutNames.size() == 0)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Cutflow \"" << name << 
+                   "\" has no cuts in ROOTTools::ThrCutflow::ThrCutflow" << std::endl;
+      exit(1);
+   }
+
+   const int nCuts = static_cast<int>(cutNames.size());
+   ROOT::TThreadedObject<TH1D> *hist = 
+      holder.AddHistogram<TH1D>(new ROOT::TThreadedObject<TH1D>(name.c_str(), name.c_str(), 
+                                                                nCuts, 0., static_cast<double>(nCuts)), 
+                                name, fileDirectory, nullptr, nCuts + 2);
+   table = new Table(hist, cutNames);
+   holder.AddFlushable(table);
+}
+
+ROOTTools::ThrObjHolder::CacheIndices& ROOTTools::ThrCutflow::GetCacheIndices()
+{
+   static ThrObjHolder::CacheIndices cacheIndices;
+   return cacheIndices;
+}
+
+ROOTTools::ThrCutflow::Counts& ROOTTools::ThrCutflow::GetCounts()
+{
+   // ids and counts of the calling thread for every ThrCutflow indexed by cacheIndex
+   thread_local std::vector<std::pair<std::uint64_t, Counts *>> threadCounts;
+
+   if (cacheIndex.index >= threadCounts.size()) threadCounts.resize(cacheIndex.index + 1, {0, nullptr});
+   std::pair<std::uint64_t, Counts *>& entry = threadCounts[cacheIndex.index];
+   // entry is empty or was left by the destroyed cutflow that had the same index
+   if (entry.first != cacheIndex.id) entry = {cacheIndex.id, &table->AddCounts()};
+   return *entry.second;
+}
+
+void ROOTTools::ThrCutflow::ExitOutOfRange(const std::size_t cut) const
+{
+   std::cout << "\033[1m\033[31mError:\033[0m Cut " << cut << 
+                " is out of range in ROOTTools::ThrCutflow::Pass: number of cuts is " << 
+                table->cutNames.size() << std::endl;
+   exit(1);
+}
+
+ROOTTools::ThrCutflow::Table::Table(ROOT::TThreadedObject<TH1D> *hist, 
+                                    const std::vector<std::string>& cutNames) : 
+   hist(hist), cutNames(cutNames) {}
+
+ROOTTools::ThrCutflow::Counts& ROOTTools::ThrCutflow::Table::AddCounts()
+{
+   Counts *threadCounts;
+   {
+      std::lock_guard<std::mutex> lock(countsMutex);
+      threadCounts = &counts.emplace_back();
+   }
+
+   // lines are allocated on the calling thread so that they are placed in its memory
+   const std::size_t valuesPerLine = sizeof(CacheLine)/sizeof(double);
+   threadCounts->lines.resize((2*cutNames.size() + valuesPerLine - 1)/valuesPerLine);
+   threadCounts->sumw = reinterpret_cast<double *>(threadCounts->lines.data());
+   threadCounts->sumw2 = threadCounts->sumw + cutNames.size();
+   return *threadCounts;
+}
+
+void ROOTTools::ThrCutflow::Table::Flush()
+{
+   // counts are added to the first copy so that the thread that flushes does not allocate its own
+   TH1D *cutflow = hist->GetAtSlotRaw(0);
+   if (!cutflow) cutflow = hist->GetAtSlot(0).get();
+   for (std::size_t i = 0; i < cutNames.size(); i++)
+   {
+      cutflow->GetXaxis()->SetBinLabel(i + 1, cutNames[i].c_str());
+   }
+
+   bool isWeighted = false;
+   for (const Counts& threadCounts : counts) isWeighted = isWeighted || threadCounts.isWeighted;
+   // same as in TH1::Fill: the array of sum of squares of weights is created 
+   // only if it was requested or if weight that is not 1 was filled
+   if (isWeighted && cutflow->GetSumw2N() == 0 && !cutflow->TestBit(TH1::kIsNotW)) cutflow->Sumw2();
+   double *sumw2 = (cutflow->GetSumw2N() > 0) ? cutflow->GetSumw2()->GetArray() : nullptr;
+
+   double entries = 0.;
+   double stats[TH1::kNstat] = {};
+   cutflow->GetStats(stats);
+
+   for (const Counts& threadCounts : counts)
+   {
+      for (std::size_t i = 0; i < cutNames.size(); i++)
+      {
+         // same as TH1::Fill(i, weight) for each counted event
+         const double x = static_cast<double>(i);
+         cutflow->AddBinContent(i + 1, threadCounts.sumw[i]);
+         if (sumw2) sumw2[i + 1] += threadCounts.sumw2[i];
+         stats[0] += threadCounts.sumw[i];
+         stats[1] += threadCounts.sumw2[i];
+         stats[2] += threadCounts.sumw[i]*x;
+         stats[3] += threadCounts.sumw[i]*x*x;
+      }
+      entries += threadCounts.nEntries;
+   }
+   Reset();
+
+   cutflow->PutStats(stats);
+   cutflow->SetEntries(cutflow->GetEntries() + entries);
+}
+
+void ROOTTools::ThrCutflow::Table::Reset()
+{
+   for (Counts& threadCounts : counts)
+   {
+      for (CacheLine& line : threadCounts.lines) line = CacheLine();
+      threadCounts.nEntries = 0.;
+      threadCounts.isWeighted = false;
+   }
+}
+
+ROOTTools::ThrTree::ThrTree(const std::string& name, const std::string& title, 
+                            const std::string& fileDirectory, ThrObjHolder::Holder& holder) : 
+   cacheIndex(GetCacheIndices())
+{
+   // files and trees are created concurrently on different threads
+   ROOT::EnableThreadSafety();
+
+   trees = new ThrObjHolder::ThreadTrees(name, title);
+   holder.AddTree(trees, fileDirectory);
+}
+
+ROOTTools::ThrObjHolder::CacheIndices& ROOTTools::ThrTree::GetCacheIndices()
+{
+   static ThrObjHolder::CacheIndices cacheIndices;
+   return cacheIndices;
+}
+
+TTree *ROOTTools::ThrTree::Get()
+{
+   // ids and trees of the calling thread for every ThrTree indexed by cacheIndex
+   thread_local std::vector<std::pair<std::uint64_t, TTree *>> threadTrees;
+
+   if (cacheIndex.index >= threadTrees.size()) threadTrees.resize(cacheIndex.index + 1, {0, nullptr});
+   std::pair<std::uint64_t, TTree *>& entry = threadTrees[cacheIndex.index];
+   // entry is empty or was left by the destroyed ThrTree that had the same index
+   if (entry.first != cacheIndex.id) entry = {cacheIndex.id, trees->AddTree()};
+   return entry.second;
+}
+
+ROOTTools::ParallelEventLoop::ParallelEventLoop(const std::string& treeName, 
+                                                const std::vector<std::string>& fileNames,
+                                                const unsigned int nThreads, 
+                                                ThrObjHolder::Holder& holder) : 
+   fileNames(fileNames), nThreads(nThreads), holder(holder)
+{
+   // TThreadedObject has as many slots as the pool of implicit multithreading has threads
+   if (this->nThreads == 0) this->nThreads = ROOT::GetThreadPoolSize();
+   if (this->nThreads == 0) this->nThreads = std::thread::hardware_concurrency();
+   treeNames.resize(fileNames.size(), treeName);
+}
+
+ROOTTools::ParallelEventLoop::ParallelEventLoop(TChain& chain, const unsigned int nThreads, 
+                                                ThrObjHolder::Holder& holder) : 
+   nThreads(nThreads), holder(holder)
+{
+   // TThreadedObject has as many slots as the pool of implicit multithreading has threads
+   if (this->nThreads == 0) this->nThreads = ROOT::GetThreadPoolSize();
+   if (this->nThreads == 0) this->nThreads = std::thread::hardware_concurrency();
+   // titles of elements of the chain are the names of the files and names are the names of the trees
+   for (TObject *element : *chain.GetListOfFiles()) 
+   {
+      fileNames.push_back(element->GetTitle());
+      const std::string treeName = element->GetName();
+      treeNames.push_back((treeName != "") ? treeName : chain.GetName());
+   }
+}
+
+void ROOTTools::ParallelEventLoop::Error::Set(const std::string& message)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   if (isSet.load(std::memory_order_relaxed)) return;
+   this->message = message;
+   isSet.store(true, std::memory_order_release);
+}
+
+bool ROOTTools::ParallelEventLoop::Error::IsSet() const
+{
+   return isSet.load(std::memory_order_acquire);
+}
+
+void ROOTTools::ParallelEventLoop::Error::Report()
+{
+   if (!IsSet()) return;
+   std::cout << "\033[1m\033[31mError:\033[0m " << message << std::endl;
+   exit(1);
+}
+
+void ROOTTools::ParallelEventLoop::SetMinTaskEntries(const Long64_t minTaskEntries)
+{
+   this->minTaskEntries = minTaskEntries;
+}
+
+std::vector<ROOTTools::ParallelEventLoop::Task> ROOTTools::ParallelEventLoop::MakeTasks()
+{
+   std::vector<std::vector<Task>> fileTasks(fileNames.size());
+   Error error;
+   // opening files is dominated by the latency of the storage hence they are opened concurrently
+   pool->Run(fileNames.size(), [&](const std::size_t i)
+   {
+      if (error.IsSet()) return;
+      std::unique_ptr<TFile> file(TFile::Open(fileNames[i].c_str(), "READ"));
+      if (!file || file->IsZombie())
+      {
+         error.Set("File " + fileNames[i] + " could not be opened in ROOTTools::ParallelEventLoop::Run");
+         return;
+      }
+      TTree *tree = file->Get<TTree>(treeNames[i].c_str());
+      if (!tree)
+      {
+         error.Set("Tree \"" + treeNames[i] + "\" was not found in " + fileNames[i] + 
+                   " in ROOTTools::ParallelEventLoop::Run");
+         return;
+      }
+
+      const Long64_t nEntries = tree->GetEntries();
+      TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+      Long64_t first = clusters();
+      while (first < nEntries)
+      {
+         // clusters are joined until the task has enough entries
+         Long64_t last = clusters.GetNextEntry();
+         while (last - first < minTaskEntries && last < nEntries) 
+         {
+            clusters();
+            last = clusters.GetNextEntry();
+         }
+         last = std::min(last, nEntries);
+         fileTasks[i].push_back({i, first, last});
+         first = clusters();
+      }
+   });
+   error.Report();
+
+   std::vector<Task> tasks;
+   for (std::vector<Task>& taskList : fileTasks) 
+   {
+      tasks.insert(tasks.end(), taskList.begin(), taskList.end());
+   }
+   return tasks;
+}
+
+bool ROOTTools::ParallelEventLoop::TakeTask(std::vector<Queue>& queues, const unsigned int thread, 
+                                           Task& task)
+{
+   {
+      std::lock_guard<std::mutex> lock(queues[thread].mutex);
+      if (queues[thread].tasks.size() > 0)
+      {
+         task = queues[thread].tasks.front();
+         queues[thread].tasks.pop_front();
+         return true;
+      }
+   }
+
+   // tasks are stolen from the back so that the owner keeps reading its current file
+   for (std::size_t i = 1; i < queues.size(); i++)
+   {
+      Queue& victim = queues[(thread + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.tasks.size() > 0)
+      {
+         task = victim.tasks.back();
+         victim.tasks.pop_back();
+         return true;
+      }
+   }
+   // tasks are never added during the loop hence empty queues stay empty
+   return false;
+}
+
+void ROOTTools::ParallelEventLoop::Run(const std::function<void(TTreeReader&)>& func, 
+                                       const std::string& outputFileName)
+{
+   ROOT::EnableThreadSafety();
+
+   // every thread of the pool takes one slot of each histogram on its first fill
+   const unsigned int nSlots = holder.GetNSlots();
+   if (nSlots != 0 && nThreads > nSlots)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Number of threads (" << nThreads << 
+                   ") of ROOTTools::ParallelEventLoop exceeds the number of slots of TThreadedObject (" << 
+                   nSlots << "); pass fewer threads or enable implicit multithreading with "\
+                   "enough threads before histograms are created" << std::endl;
+      exit(1);
+   }
+   if (!pool) pool = std::make_unique<ThrObjHolder::ThreadPool>(nThreads);
+
+   const std::vector<Task> tasks = MakeTasks();
+
+   Long64_t nEntries = 0;
+   for (const Task& task : tasks) nEntries += task.last - task.first;
+
+   // each thread gets a contiguous block of tasks with about nEntries/nThreads entries
+   std::vector<Queue> queues(nThreads);
+   Long64_t nDealtEntries = 0;
+   for (const Task& task : tasks)
+   {
+      const unsigned int thread = 
+         std::min<unsigned int>(static_cast<double>(nDealtEntries)/nEntries*nThreads, nThreads - 1);
+      queues[thread].tasks.push_back(task);
+      nDealtEntries += task.last - task.first;
+   }
+
+   std::vector<std::vector<ClusterTiming>> threadTimings(nThreads);
+   Error error;
+   // every index is the queue of one thread; threads of the pool take indices one by one hence 
+   // a thread that finished its queue early may process the queue that was not taken yet
+   pool->Run(nThreads, [&](const std::size_t queueIndex)
+   {
+      const unsigned int i = queueIndex;
+      // file is kept open until the thread takes the task from another file
+      std::unique_ptr<TFile> file;
+      TTree *tree = nullptr;
+      std::size_t fileIndex = fileNames.size();
+
+      Task task;
+      // remaining tasks are dropped after the error since the program exits when all threads stop
+      while (!error.IsSet() && TakeTask(queues, i, task))
+      {
+         if (task.file != fileIndex)
+         {
+            tree = nullptr;
+            file.reset(TFile::Open(fileNames[task.file].c_str(), "READ"));
+            if (file && !file->IsZombie()) tree = file->Get<TTree>(treeNames[task.file].c_str());
+            if (!tree)
+            {
+               error.Set("Tree \"" + treeNames[task.file] + "\" could not be read from " + 
+                         fileNames[task.file] + " in ROOTTools::ParallelEventLoop::Run");
+               return;
+            }
+            fileIndex = task.file;
+         }
+
+         const auto start = std::chrono::steady_clock::now();
+         {
+            TTreeReader reader(tree);
+            reader.SetEntriesRange(task.first, task.last);
+            func(reader);
+         }
+         const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+         threadTimings[i].push_back({task.file, task.first, task.last, i, duration.count()});
+      }
+   });
+   error.Report();
+
+   timings.clear();
+   for (std::vector<ClusterTiming>& threadTiming : threadTimings) 
+   {
+      timings.insert(timings.end(), threadTiming.begin(), threadTiming.end());
+   }
+   std::sort(timings.begin(), timings.end(), [](const ClusterTiming& a, const ClusterTiming& b)
+   {
+      return (a.file != b.file) ? a.file < b.file : a.first < b.first;
+   });
+
+   if (outputFileName != "") holder.Write(outputFileName);
+}
+
+const std::vector<ROOTTools::ParallelEventLoop::ClusterTiming>& 
+ROOTTools::ParallelEventLoop::GetTimings() const
+{
+   return timings;
+}
+
+void ROOTTools::ParallelEventLoop::PrintTimings(const std::size_t nSlowest) const
+{
+   if (timings.size() == 0)
+   {
+      std::cout << "ROOTTools::ParallelEventLoop: no tasks were processed" << std::endl;
+      return;
+   }
+
+   std::vector<double> threadSeconds(nThreads, 0.);
+   std::vector<std::size_t> threadTasks(nThreads, 0);
+   std::vector<Long64_t> threadEntries(nThreads, 0);
+   for (const ClusterTiming& timing : timings)
+   {
+      threadSeconds[timing.thread] += timing.seconds;
+      threadTasks[timing.thread]++;
+      threadEntries[timing.thread] += timing.last - timing.first;
+   }
+
+   // format of std::cout is restored at the end
+   const std::ios_base::fmtflags flags = std::cout.flags();
+   const std::streamsize precision = std::cout.precision();
+
+   std::cout << "ROOTTools::ParallelEventLoop: " << timings.size() << " tasks on " << 
+                nThreads << " threads" << std::endl;
+   for (unsigned int i = 0; i < nThreads; i++)
+   {
+      std::cout << "   thread " << std::setw(3) << i << ": " << std::setw(6) << threadTasks[i] << 
+                   " tasks, " << std::setw(12) << threadEntries[i] << " entries, " << 
+                   std::fixed << std::setprecision(3) << threadSeconds[i] << " s" << std::endl;
+   }
+
+   // the loop lasts as long as the slowest thread while the work could have been spread evenly
+   const double maxThreadSeconds = *std::max_element(threadSeconds.begin(), threadSeconds.end());
+   double meanThreadSeconds = 0.;
+   for (const double seconds : threadSeconds) meanThreadSeconds += seconds/nThreads;
+   std::cout << "   load imbalance (slowest thread/mean): " << std::setprecision(3) << 
+                ((meanThreadSeconds > 0.) ? maxThreadSeconds/meanThreadSeconds : 1.) << std::endl;
+
+   std::vector<const ClusterTiming *> sortedTimings;
+   for (const ClusterTiming& timing : timings) sortedTimings.push_back(&timing);
+   std::sort(sortedTimings.begin(), sortedTimings.end(), 
+             [](const ClusterTiming *a, const ClusterTiming *b) { return a->seconds > b->seconds; });
+
+   std::cout << "   task time: min " << sortedTimings.back()->seconds << " s, mean " << 
+                std::accumulate(threadSeconds.begin(), threadSeconds.end(), 0.)/timings.size() << 
+                " s, max " << sortedTimings.front()->seconds << " s" << std::endl;
+   for (std::size_t i = 0; i < std::min(nSlowest, sortedTimings.size()); i++)
+   {
+      std::cout << "   " << fileNames[sortedTimings[i]->file] << " entries [" << 
+                   sortedTimings[i]->first << ", " << sortedTimings[i]->last << "): " << 
+                   sortedTimings[i]->seconds << " s on thread " << sortedTimings[i]->thread << std::endl;
+   }
+   std::cout.flags(flags);
+   std::cout.precision(precision);
+}
+
+// explicit instantiations of ROOTTools::ThrCounter for types of TParameter that can be summed
+template ROOTTools::ThrCounter<Long64_t>::ThrCounter(const std::string&, const std::string&, 
+                                                     ThrObjHolder::Holder&);
+template ROOTTools::ThrCounter<double>::ThrCounter(const std::string&, const std::string&, 
+                                                   ThrObjHolder::Holder&);
+template ROOTTools::ThrCounter<Long64_t>::Slot& ROOTTools::ThrCounter<Long64_t>::GetSlot();
+template ROOTTools::ThrCounter<double>::Slot& ROOTTools::ThrCounter<double>::GetSlot();
+
+// explicit instantiations of ROOTTools::ThrObjHolder::Holder::AddHistogram for all types that can be held;
+// new type is supported by instantiating it here (and instantiating ThrObj functions for it below)
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER(T) \
+template ROOT::TThreadedObject<T> * \
+ROOTTools::ThrObjHolder::Holder::AddHistogram(ROOT::TThreadedObject<T> *, \
+                                              const std::string&, const std::string&, \
+                                              ROOTTools::ThrObjHolder::CheckpointValues<T> *, \
+                                              const std::size_t);
+
+// explicit instantiations of ROOTTools::ThrObj::Get(), ROOTTools::ThrObj::GetRaw(), and ROOTTools::ThrObj::Get(slot)
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_GET(T) \
+template std::shared_ptr<T> ROOTTools::ThrObj<T>::Get(); \
+template T *ROOTTools::ThrObj<T>::GetRaw(); \
+template std::shared_ptr<T> ROOTTools::ThrObj<T>::Get(const unsigned int);
+
+// explicit instantiations of ROOTTools::ThrObj constructors with fixed and variable width bins
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_1D(T) \
+template ROOTTools::ThrObj<T>::ThrObj(const std::string&, const std::string&, \
+                                      const int, const double, const double, \
+                                      const std::string&, \
+                                      ThrObjHolder::Holder&); \
+template ROOTTools::ThrObj<T>::ThrObj(const std::string&, const std::string&, \
+                                      const std::vector<double>&, \
+                                      const std::string&, \
+                                      ThrObjHolder::Holder&);
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_2D(T) \
+template ROOTTools::ThrObj<T>::ThrObj(const std::string&, const std::string&, \
+                                      const int, const double, const double, \
+                                      const int, const double, const double, \
+                                      const std::string&, \
+                                      ThrObjHolder::Holder&); \
+template ROOTTools::ThrObj<T>::ThrObj(const std::string&, const std::string&, \
+                                      const std::vector<double>&, const std::vector<double>&, \
+                                      const std::string&, \
+                                      ThrObjHolder::Holder&);
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_3D(T) \
+template ROOTTools::ThrObj<T>::ThrObj(const std::string&, const std::string&, \
+                                      const int, const double, const double, \
+                                      const int, const double, const double, \
+                                      const int, const double, const double, \
+                                      const std::string&, \
+                                      ThrObjHolder::Holder&); \
+template ROOTTools::ThrObj<T>::ThrObj(const std::string&, const std::string&, \
+                                      const std::vector<double>&, const std::vector<double>&, \
+                                      const std::vector<double>&, \
+                                      const std::string&, \
+                                      ThrObjHolder::Holder&);
+
+// explicit instantiations of ROOTTools::ThrObj functions for histograms with nDim dimensions: 
+// the constructor used by StaticThrObj, fill buffer, storage, and compact counters functions
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_HIST(T, nDim) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER(T) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_GET(T) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_##nDim##D(T) \
+template ROOTTools::ThrObj<T>::ThrObj(const std::string&, const std::string&, \
+                                      const std::array<int, nDim>&, const std::array<double, nDim>&, \
+                                      const std::array<double, nDim>&, const std::string&, \
+                                      ThrObjHolder::Holder&); \
+template ROOTTools::ThrObj<T>::ThreadCache& ROOTTools::ThrObj<T>::GetThreadCache(); \
+template void ROOTTools::ThrObj<T>::SetFillBuffer(const std::size_t); \
+template void ROOTTools::ThrObj<T>::FlushFillBuffer(); \
+template void ROOTTools::ThrObj<T>::StorageFill(const std::array<double, nDim + 1>&); \
+template void ROOTTools::ThrObj<T>::SetCompactCounters();
+
+// explicit instantiations of ROOTTools::ThrObj for 1D histograms; shared atomic bins are supported only by them
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_1D(T) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HIST(T, 1) \
+template void ROOTTools::ThrObj<T>::FillN(std::span<const double>, std::span<const double>); \
+template void ROOTTools::ThrObj<T>::SetSharedAtomicBins();
+// explicit instantiations of ROOTTools::ThrObj for 2D histograms; sparse bins are supported only by 2D and 3D ones
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_2D(T) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HIST(T, 2) \
+template void ROOTTools::ThrObj<T>::FillN(std::span<const double>, std::span<const double>, \
+                                          std::span<const double>); \
+template void ROOTTools::ThrObj<T>::SetSparseBins();
+// explicit instantiations of ROOTTools::ThrObj for 3D histograms
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE_3D(T) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HIST(T, 3) \
+template void ROOTTools::ThrObj<T>::FillN(std::span<const double>, std::span<const double>, \
+                                          std::span<const double>, std::span<const double>); \
+template void ROOTTools::ThrObj<T>::SetSparseBins();
+
+// explicit instantiations of ROOTTools::ThrObj for histograms of all dimensions with the given type of contents
+#define ROOT_TOOLS_THR_OBJ_INSTANTIATE(type) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_1D(TH1##type) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_2D(TH2##type) \
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_3D(TH3##type)
+
+ROOT_TOOLS_THR_OBJ_INSTANTIATE(F)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE(D)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE(L)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE(S)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE(I)
+
+// profiles and efficiencies support only constructors, Get, and Fill
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER(TProfile)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_GET(TProfile)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_1D(TProfile)
+
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER(TProfile2D)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_GET(TProfile2D)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_2D(TProfile2D)
+
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER(TEfficiency)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_GET(TEfficiency)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_1D(TEfficiency)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_2D(TEfficiency)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_3D(TEfficiency)
+
+// values of ThrCounter
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER(TParameter<Long64_t>)
+ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER(TParameter<double>)
+
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_3D
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_2D
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_1D
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_HIST
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_3D
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_2D
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_CTORS_1D
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_GET
+#undef ROOT_TOOLS_THR_OBJ_INSTANTIATE_HOLDER
 
 #endif /* ROOT_TOOLS_THR_OBJ_CPP */
@@ -0,0 +1,291 @@
+/**
+ *  @file   ThrObjTest.cpp
+ *  @brief  Test that compares histograms filled on many threads with ThrObj in every fill mode with the same histograms filled serially
+ *
+ *  Usage: ThrObjTest
+ *
+ *  Every thread fills its own values at the centers of bins (including underflow and overflow bins) so that bins do not depend on the rounding of the edges. Histograms written by the holder are compared with the ones filled serially with T::Fill bin by bin together with errors, the number of entries, and statistics. The checkpoint test compares the checkpoint written between two parts of the fill with the histogram filled serially with the first part, and the histogram resumed from the checkpoint in the new holder and filled with the second part with the one filled serially with both parts. The program returns 1 if any histogram differs
+ *
+ *  This file is a part of a project ROOTTools (https://github.com/Sergeyir/ROOTTools).
+ *
+ *  @author Sergei Antsupov (antsupov0124@gmail.com)
+ **/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+#include "TMemFile.h"
+
+#include "ThrObj.hpp"
+
+/// Number of threads that fill histograms
+constexpr unsigned int nThreads = 4;
+/// Number of values filled by each thread
+constexpr std::size_t nValues = 100000;
+/// Number of bins on each axis
+constexpr int nBins = 100;
+
+/// Values filled by one thread: X, Y, and the weight
+using Values = std::vector<std::array<double, 3>>;
+
+/// Returns values of every thread at the centers of bins on [0, 1] axes; weights are 1 if unitWeights is true and 1, 0.5, or 2 otherwise
+std::vector<Values> GenerateValues(const bool unitWeights)
+{
+   std::vector<Values> values(nThreads);
+   for (unsigned int i = 0; i < nThreads; i++)
+   {
+      std::mt19937_64 generator(i);
+      // -1 and nBins are the underflow and the overflow bins
+      std::uniform_int_distribution<int> bin(-1, nBins);
+      std::uniform_int_distribution<int> weight(0, 2);
+      for (std::size_t j = 0; j < nValues; j++)
+      {
+         values[i].push_back({(bin(generator) + 0.5)/nBins, (bin(generator) + 0.5)/nBins,
+                              unitWeights ? 1. : std::array<double, 3>{1., 0.5, 2.}[weight(generator)]});
+      }
+   }
+   return values;
+}
+
+/// Fills the value into the histogram of ROOT or ThrObj with nDim dimensions
+template<std::size_t nDim, typename Hist>
+void FillValue(Hist& hist, const std::array<double, 3>& value)
+{
+   if constexpr (nDim == 1) hist.Fill(value[0], value[2]);
+   else hist.Fill(value[0], value[1], value[2]);
+}
+
+/// Returns true if the numbers are equal up to the rounding errors of the different order of the summation
+bool IsClose(const double a, const double b)
+{
+   return std::abs(a - b) <= 1e-9*std::max({1., std::abs(a), std::abs(b)});
+}
+
+/// Returns true if contents, errors, the number of entries, and statistics of the histograms are the same; prints the error otherwise
+bool Compare(const TH1 *result, const TH1 *reference, const std::string& test)
+{
+   if (!result)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Histogram " << reference->GetName() <<
+                   " was not written in test " << test << std::endl;
+      return false;
+   }
+
+   bool isEqual = (result->GetNcells() == reference->GetNcells()) &&
+                  IsClose(result->GetEntries(), reference->GetEntries());
+   for (int bin = 0; isEqual && bin < reference->GetNcells(); bin++)
+   {
+      isEqual = IsClose(result->GetBinContent(bin), reference->GetBinContent(bin)) &&
+                IsClose(result->GetBinError(bin), reference->GetBinError(bin));
+   }
+   double resultStats[TH1::kNstat] = {}, referenceStats[TH1::kNstat] = {};
+   result->GetStats(resultStats);
+   reference->GetStats(referenceStats);
+   for (int i = 0; isEqual && i < TH1::kNstat; i++) isEqual = IsClose(resultStats[i], referenceStats[i]);
+
+   if (!isEqual)
+   {
+      std::cout << "\033[1m\033[31mError:\033[0m Histogram " << reference->GetName() <<
+                   " written in test " << test << " differs from the one filled serially" << std::endl;
+   }
+   return isEqual;
+}
+
+/// Fills hist on nThreads threads and the reference serially, writes hist with its holder, and compares them
+template<std::size_t nDim, typename Hist, typename T>
+bool FillAndCompare(const std::string& test, ROOTTools::ThrObjHolder::Holder& holder,
+                    Hist& hist, T& reference, const std::vector<Values>& values)
+{
+   std::vector<std::thread> pool;
+   for (const Values& threadValues : values)
+   {
+      pool.emplace_back([&]()
+      {
+         for (const std::array<double, 3>& value : threadValues) FillValue<nDim>(hist, value);
+      });
+   }
+   for (std::thread& thr : pool) thr.join();
+
+   for (const Values& threadValues : values)
+   {
+      for (const std::array<double, 3>& value : threadValues) FillValue<nDim>(reference, value);
+   }
+
+   TMemFile file("ThrObjTest.root", "RECREATE");
+   TDirectory::TContext context(&file);
+   holder.Write();
+   std::unique_ptr<T> result(file.Get<T>(reference.GetName()));
+   return Compare(result.get(), &reference, test);
+}
+
+/// Resumes the fill from the checkpoint written after the first part of the values, fills the second part in the new holder, and compares the written histogram with both parts
+bool TestResume(const std::string& checkpointFileName, const std::vector<Values>& values, 
+                const TH1D& bothParts)
+{
+   ROOTTools::ThrObjHolder::Holder holder;
+   ROOTTools::ThrObj<TH1D> hist("checkpoint", "", nBins, 0., 1., "", holder);
+   holder.Resume(checkpointFileName);
+
+   std::vector<std::thread> pool;
+   for (const Values& threadValues : values)
+   {
+      pool.emplace_back([&]()
+      {
+         for (std::size_t i = threadValues.size()/2; i < threadValues.size(); i++)
+         {
+            FillValue<1>(hist, threadValues[i]);
+         }
+      });
+   }
+   for (std::thread& thr : pool) thr.join();
+
+   TMemFile file("ThrObjTest.root", "RECREATE");
+   TDirectory::TContext context(&file);
+   holder.Write();
+   std::unique_ptr<TH1D> result(file.Get<TH1D>("checkpoint"));
+   return Compare(result.get(), &bothParts, "resume");
+}
+
+/// Compares the checkpoint written between two parts of the fill with the first part, and the written histogram and the one resumed from the checkpoint with both parts
+bool TestCheckpoint()
+{
+   const std::string checkpointFileName = "ThrObjTest_checkpoint.root";
+   const std::vector<Values> values = GenerateValues(false);
+
+   ROOTTools::ThrObjHolder::Holder holder;
+   holder.SetCheckpoints(true);
+   ROOTTools::ThrObj<TH1D> hist("checkpoint", "", nBins, 0., 1., "", holder);
+   hist.SetFillBuffer(256);
+   TH1D firstPart("checkpoint", "", nBins, 0., 1.);
+   TH1D bothParts("checkpoint", "", nBins, 0., 1.);
+
+   // threads wait after the first half of their values until the checkpoint is started
+   std::atomic<unsigned int> nWaiting{0};
+   std::atomic<bool> isStarted{false};
+   std::vector<std::thread> pool;
+   for (const Values& threadValues : values)
+   {
+      pool.emplace_back([&]()
+      {
+         for (std::size_t i = 0; i < threadValues.size(); i++)
+         {
+            if (i == threadValues.size()/2)
+            {
+               nWaiting++;
+               while (!isStarted) std::this_thread::yield();
+            }
+            FillValue<1>(hist, threadValues[i]);
+         }
+      });
+   }
+   while (nWaiting != nThreads) std::this_thread::yield();
+   holder.Checkpoint(checkpointFileName, 60.);
+   isStarted = true;
+   for (std::thread& thr : pool) thr.join();
+
+   for (const Values& threadValues : values)
+   {
+      for (std::size_t i = 0; i < threadValues.size(); i++)
+      {
+         if (i < threadValues.size()/2) FillValue<1>(firstPart, threadValues[i]);
+         FillValue<1>(bothParts, threadValues[i]);
+      }
+   }
+
+   bool isEqual;
+   {
+      // Write waits for the checkpoint to be finished
+      TMemFile file("ThrObjTest.root", "RECREATE");
+      TDirectory::TContext context(&file);
+      holder.Write();
+      std::unique_ptr<TH1D> result(file.Get<TH1D>("checkpoint"));
+      isEqual = Compare(result.get(), &bothParts, "checkpoint write");
+   }
+
+   std::unique_ptr<TFile> checkpointFile(TFile::Open(checkpointFileName.c_str(), "READ"));
+   std::unique_ptr<TH1D> checkpoint(checkpointFile ? checkpointFile->Get<TH1D>("checkpoint") : nullptr);
+   isEqual &= Compare(checkpoint.get(), &firstPart, "checkpoint");
+   checkpointFile.reset();
+   isEqual &= TestResume(checkpointFileName, values, bothParts);
+   std::remove(checkpointFileName.c_str());
+   return isEqual;
+}
+
+int main()
+{
+   ROOT::EnableThreadSafety();
+   // histograms read from files and the serial ones with the same names are not attached to directories
+   TH1::AddDirectory(false);
+
+   const std::vector<Values> values = GenerateValues(false);
+   bool isPassed = true;
+
+   {
+      ROOTTools::ThrObjHolder::Holder holder;
+      ROOTTools::ThrObj<TH1D> hist("dense", "", nBins, 0., 1., "", holder);
+      TH1D reference("dense", "", nBins, 0., 1.);
+      isPassed &= FillAndCompare<1>("dense", holder, hist, reference, values);
+   }
+   {
+      // bins are found with lookups of the edges instead of T::Fill
+      std::vector<double> edges;
+      for (int i = 0; i <= nBins; i++) edges.push_back(static_cast<double>(i)/nBins);
+      ROOTTools::ThrObjHolder::Holder holder;
+      ROOTTools::ThrObj<TH2D> hist("variable", "", edges, edges, "", holder);
+      TH2D reference("variable", "", nBins, edges.data(), nBins, edges.data());
+      isPassed &= FillAndCompare<2>("variable", holder, hist, reference, values);
+   }
+   {
+      ROOTTools::ThrObjHolder::Holder holder;
+      ROOTTools::ThrObj<TH1D> hist("buffer", "", nBins, 0., 1., "", holder);
+      hist.SetFillBuffer(256);
+      TH1D reference("buffer", "", nBins, 0., 1.);
+      isPassed &= FillAndCompare<1>("buffer", holder, hist, reference, values);
+   }
+   {
+      ROOTTools::ThrObjHolder::Holder holder;
+      ROOTTools::ThrObj<TH1D> hist("atomic", "", nBins, 0., 1., "", holder);
+      hist.SetSharedAtomicBins();
+      TH1D reference("atomic", "", nBins, 0., 1.);
+      isPassed &= FillAndCompare<1>("atomic", holder, hist, reference, values);
+   }
+   {
+      ROOTTools::ThrObjHolder::Holder holder;
+      ROOTTools::ThrObj<TH2D> hist("sparse", "", nBins, 0., 1., nBins, 0., 1., "", holder);
+      hist.SetSparseBins();
+      TH2D reference("sparse", "", nBins, 0., 1., nBins, 0., 1.);
+      isPassed &= FillAndCompare<2>("sparse", holder, hist, reference, values);
+   }
+   {
+      // every thread fills one bin more than UINT16_MAX times so that its counters are promoted
+      std::vector<Values> compactValues = GenerateValues(true);
+      for (Values& threadValues : compactValues)
+      {
+         threadValues.insert(threadValues.end(), 70000, {0.5/nBins, 0.5/nBins, 1.});
+      }
+      ROOTTools::ThrObjHolder::Holder holder;
+      ROOTTools::ThrObj<TH1D> hist("compact", "", nBins, 0., 1., "", holder);
+      hist.SetCompactCounters();
+      TH1D reference("compact", "", nBins, 0., 1.);
+      isPassed &= FillAndCompare<1>("compact", holder, hist, reference, compactValues);
+   }
+   {
+      ROOTTools::ThrObjHolder::Holder holder;
+      ROOTTools::StaticThrObj<TH1D, ROOTTools::StaticAxis<nBins, 0, 1>> hist("static", "", "", holder);
+      TH1D reference("static", "", nBins, 0., 1.);
+      isPassed &= FillAndCompare<1>("static", holder, hist, reference, values);
+   }
+   isPassed &= TestCheckpoint();
+
+   if (!isPassed) return 1;
+   std::cout << "All ThrObj tests passed" << std::endl;
+   return 0;
+}